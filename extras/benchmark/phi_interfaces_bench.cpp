@@ -0,0 +1,702 @@
+/** \file
+ *  \brief     Host benchmark for phi_interfaces with synthetic contact-bounce, ADC-noise and encoder-jitter models.
+ *  \details   Every device class in phi_interfaces.h is driven through the host Arduino stand-in in extras/host. A simulated panel answers the library's digitalRead(), analogRead() and shiftOut() calls from a schedule of key presses.
+ *  Each press bounces for a while before it settles, each gap between presses carries one short glitch that should NOT be reported, analog readings carry noise and encoder edges carry jitter.
+ *  For every class and every debounce time requested, one line is printed with scans per second (PC time), target time per scan (virtual time spent in analogRead() and delay(), average and worst single call), p50/p99 key-to-event latency (virtual time from first contact to getKey() returning the key), and false and missed event counts.
+ *  Output is JSON lines by default or CSV with --csv, so results can be collected and compared over time.
+ *
+ *  Build and run from the library folder:
+ *
+ *  g++ -O2 -DARDUINO=10605 -I extras/host -I . extras/benchmark/phi_interfaces_bench.cpp extras/host/host_arduino.cpp phi_interfaces.cpp -o phi_interfaces_bench
+ *
+ *  ./phi_interfaces_bench --debounce=5,10,25,50 --bounce-us=3000 --noise=4 --jitter-us=300
+ *
+ *  Options (defaults in brackets):
+ *  --debounce=list   debounce times to sweep in ms, fractions allowed with --clock=us [5,10,25,50]
+ *  --clock=ms|us     run the library on millis() or on micros() with set_clock() [ms]
+ *  --bounce-us=n     contact bounce duration after each make and break [3000]
+ *  --glitch-us=n     longest glitch injected between presses [2000]
+ *  --noise=n         peak ADC noise in counts [4]
+ *  --jitter-us=n     encoder edge jitter duration [300]
+ *  --step-us=n       time between encoder quadrature states while turning [2000]
+ *  --poll-us=n       main loop period, time between getKey() calls [1000]
+ *  --hold-ms=n       how long each press is held [120]
+ *  --gap-ms=n        minimum gap between presses [80]
+ *  --events=n        presses or detents per run [200]
+ *  --seed=n          random seed [1]
+ *  --slice=n         columns or analog pins sensed per getKey() on keypads that support set_slice(), 0 for full scans [0]
+ *  --chatter-us=n    average time between short drop-outs of a held key, 0 for none [0]
+ *  --integrator=on,off,max  debounce keypads with set_integrator() and these sample counts instead of the debounce time [off]
+ *  --chords=ms       register one chord of scan codes 0 and 1 with this window on keypads [0, none]. Every press of another key then overlaps a 4ms tap on key 0, which opens the chord window but is too short to report.
+ *                    p50/p99 cover the other keys only and keys 0 and 1 get their own p50, so this shows that only chord keys wait for the window. Use it on keypads that sense several keys at once and with debounce times of 5ms or more.
+ *  --class=name      run only this class
+ *  --csv             CSV output instead of JSON lines
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#include <Arduino.h>
+#include <phi_interfaces.h>
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct bench_params{
+  std::vector<double> debounce_ms;
+  bool clock_us;
+  unsigned long bounce_us;
+  unsigned long glitch_us;
+  int noise;
+  unsigned long jitter_us;
+  unsigned long step_us;
+  unsigned long poll_us;
+  unsigned long hold_ms;
+  unsigned long gap_ms;
+  unsigned int events;
+  unsigned long seed;
+  unsigned int slice;
+  unsigned long chatter_us;
+  byte integrator[3];           // on, off and max, or all 0 for the debounce time
+  unsigned int chord_window;    // ms, or 0 for no chord
+  std::string only_class;
+  bool csv;
+};
+
+static bench_params P;
+
+// Random numbers: xorshift32 so every platform gets the same schedule for the same seed.
+static uint32_t rng_state=1;
+static uint32_t rng()
+{
+  rng_state^=rng_state<<13;
+  rng_state^=rng_state>>17;
+  rng_state^=rng_state<<5;
+  return rng_state;
+}
+static unsigned long rng_range(unsigned long lo, unsigned long hi) // lo to hi inclusive
+{
+  if (hi<=lo) return lo;
+  return lo+rng()%(hi-lo+1);
+}
+static int adc_noise() // Triangular noise between -P.noise and +P.noise
+{
+  if (P.noise<=0) return 0;
+  int span=2*P.noise+1;
+  return (int)((rng()%span+rng()%span)/2)-P.noise;
+}
+static int clamp_adc(int v)
+{
+  if (v<0) return 0;
+  if (v>1023) return 1023;
+  return v;
+}
+
+/*
+Contact model: a list of contacts, each with a bounce toggle list. At any virtual time at most one contact is active.
+A contact is closed at time t if an odd number of its toggles happened at or before t.
+*/
+struct contact{
+  unsigned long long t_start;   // First toggle
+  unsigned long long t_end;     // Last toggle
+  byte key;                     // Simulated key index
+  bool real;                    // false for glitches, which must not be reported
+  bool detected;
+  std::vector<unsigned long long> toggles;
+  std::vector<byte> states;     // Encoders only: quadrature state after each toggle
+};
+
+static std::vector<contact> contacts;
+static size_t active=0;         // Index of the first contact that may still be active
+static std::vector<contact> overlays; // Contacts that overlap the ones above, such as the chord key taps of --chords
+static size_t overlay=0;        // Index of the first overlay that may still be active
+
+static void add_bounce(std::vector<unsigned long long> &tg, unsigned long long t, unsigned long dur)
+{
+  unsigned long long end=t+dur;
+  tg.push_back(t);
+  while (true)
+  {
+    t+=rng_range(20,300);
+    if (t>=end) break;
+    tg.push_back(t);
+    t+=rng_range(20,300);
+    tg.push_back(t<end?t:end);
+  }
+}
+
+static const contact *active_contact()
+{
+  unsigned long long now=host_time_us();
+  while ((active<contacts.size())&&(contacts[active].t_end<now)) active++;
+  if ((active<contacts.size())&&(contacts[active].t_start<=now)) return &contacts[active];
+  return 0;
+}
+
+static bool closed_at(const contact &c, unsigned long long now)
+{
+  size_t n=std::upper_bound(c.toggles.begin(),c.toggles.end(),now)-c.toggles.begin();
+  return (n&1);
+}
+
+static bool key_closed(byte key)
+{
+  unsigned long long now=host_time_us();
+  const contact *c=active_contact();
+  if (c&&(c->key==key)&&closed_at(*c,now)) return true;
+  while ((overlay<overlays.size())&&(overlays[overlay].t_end<now)) overlay++;
+  return (overlay<overlays.size())&&(overlays[overlay].key==key)&&closed_at(overlays[overlay],now);
+}
+
+static byte encoder_state() // Quadrature state as the decoder sees it, 3 at rest
+{
+  const contact *c=active_contact();
+  if (c==0) return 3;
+  unsigned long long now=host_time_us();
+  size_t n=std::upper_bound(c->toggles.begin(),c->toggles.end(),now)-c->toggles.begin();
+  if (n==0) return 3;
+  return c->states[n-1];
+}
+
+static void make_key_schedule(byte n_keys, const byte *valid)
+{
+  unsigned long long t=100000;
+  for (unsigned int e=0;e<P.events;e++)
+  {
+    contact g;
+    unsigned long gap=P.gap_ms*1000+rng_range(0,P.gap_ms*1000);
+    g.t_start=t+gap/2;
+    g.key=valid?valid[rng()%n_keys]:rng()%n_keys;
+    g.real=false;
+    g.detected=false;
+    add_bounce(g.toggles,g.t_start,rng_range(P.glitch_us/2,P.glitch_us));
+    if (!(g.toggles.size()&1)) g.toggles.pop_back();
+    g.toggles.push_back(g.toggles.back()+1); // Glitch ends open
+    g.t_end=g.toggles.back();
+    if (P.glitch_us) contacts.push_back(g);
+
+    contact c;
+    c.t_start=t+gap;
+    c.key=valid?valid[rng()%n_keys]:rng()%n_keys;
+    c.real=true;
+    c.detected=false;
+    add_bounce(c.toggles,c.t_start,P.bounce_us);
+    if (P.chatter_us) // Drop-outs while held, ending closed before the release bounce.
+    {
+      unsigned long long tc=c.toggles.back()+rng_range(P.chatter_us/2,P.chatter_us*3/2);
+      while (tc+300<c.t_start+P.hold_ms*1000)
+      {
+        c.toggles.push_back(tc);
+        c.toggles.push_back(tc+rng_range(20,300));
+        tc=c.toggles.back()+rng_range(P.chatter_us/2,P.chatter_us*3/2);
+      }
+    }
+    add_bounce(c.toggles,c.t_start+P.hold_ms*1000,P.bounce_us);
+    c.t_end=c.toggles.back();
+    contacts.push_back(c);
+    if (P.chord_window&&(c.key>1)) // A clean 4ms tap on chord key 0 from 2ms before the press.
+    {
+      contact o;
+      o.key=0;
+      o.real=false;
+      o.detected=false;
+      o.t_start=c.t_start-2000;
+      o.toggles.push_back(o.t_start);
+      o.toggles.push_back(o.t_start+4000);
+      o.t_end=o.toggles.back();
+      overlays.push_back(o);
+    }
+    t=c.t_end;
+  }
+}
+
+static void make_encoder_schedule()
+{
+  static const byte up_seq[]={2,0,1,3};
+  static const byte down_seq[]={1,0,2,3};
+  unsigned long long t=100000;
+  for (unsigned int e=0;e<P.events;e++)
+  {
+    contact c;
+    c.key=rng()&1;
+    c.real=true;
+    c.detected=false;
+    c.t_start=t+P.gap_ms*1000/4+rng_range(0,P.gap_ms*1000/4);
+    const byte *seq=c.key?down_seq:up_seq;
+    byte prev=3;
+    unsigned long long te=c.t_start;
+    for (byte i=0;i<4;i++)
+    {
+      std::vector<unsigned long long> tg;
+      add_bounce(tg,te,P.jitter_us);
+      for (size_t k=0;k<tg.size();k++)
+      {
+        c.toggles.push_back(tg[k]);
+        c.states.push_back((k&1)?prev:seq[i]);
+      }
+      prev=seq[i];
+      te+=P.step_us;
+    }
+    c.t_end=c.toggles.back()+P.step_us;
+    contacts.push_back(c);
+    t=c.t_end;
+  }
+}
+
+/*
+Simulated panels. Each install function wires hooks that turn the contact model into pin levels for one device class.
+*/
+// Button group on pins 2-5
+static const byte group_pins[]={2,3,4,5};
+static int group_read(uint8_t pin)
+{
+  for (byte i=0;i<4;i++) if (group_pins[i]==pin) return key_closed(i)?LOW:HIGH;
+  return HIGH;
+}
+
+// 4X4 matrix, rows on 6-9 and columns on 10-13
+static const byte matrix_pins[]={6,7,8,9,10,11,12,13};
+static int matrix_read(uint8_t pin)
+{
+  for (byte r=0;r<4;r++)
+  {
+    if (matrix_pins[r]!=pin) continue;
+    for (byte c=0;c<4;c++)
+    {
+      byte cp=matrix_pins[4+c];
+      if ((host_pins.mode[cp]==OUTPUT)&&(host_pins.level[cp]==LOW)&&key_closed(r*4+c)) return LOW;
+    }
+    return HIGH;
+  }
+  return HIGH;
+}
+
+// Liudr shift register pad, rows on 8-9, data 15, latch 16, clock 17
+static const byte liudr_rows[]={8,9};
+static byte liudr_shift_count=0;
+static byte liudr_columns=255;
+static byte liudr_pending=255;
+static void liudr_pin_write(uint8_t pin)
+{
+  if (pin!=16) return;
+  if (host_pins.level[16]==LOW) liudr_shift_count=0;
+  else liudr_columns=liudr_pending; // Latch
+}
+static void liudr_shift(uint8_t, uint8_t, uint8_t, uint8_t val)
+{
+  if (liudr_shift_count==1) liudr_pending=val;
+  liudr_shift_count++;
+}
+static int liudr_read(uint8_t pin)
+{
+  for (byte j=0;j<2;j++)
+  {
+    if (liudr_rows[j]!=pin) continue;
+    for (byte i=0;i<8;i++) if (!bitRead(liudr_columns,i)&&key_closed(i+j*8)) return LOW;
+  }
+  return HIGH;
+}
+
+// Liudr pad 2, columns on 2-5, LEDs on 6-9, analog sense on A0, 3 rows
+static const byte liudr2_pins[]={2,3,4,5,6,7,8,9};
+static int liudr2_values[]={100,300,500,800,1023};
+static int liudr2_read(uint8_t pin)
+{
+  if (pin!=A0) return 1023;
+  for (byte k=0;k<4;k++)
+  {
+    byte cp=liudr2_pins[k];
+    if ((host_pins.mode[cp]!=OUTPUT)||(host_pins.level[cp]!=LOW)) continue;
+    for (byte i=0;i<3;i++) if (key_closed(i+k*3)) return clamp_adc(liudr2_values[i]+adc_noise());
+  }
+  return clamp_adc(liudr2_values[3]+adc_noise());
+}
+
+// Analog keypad with 2 analog pins and 5 buttons each
+static const byte analog_pins[]={0,1};
+static int analog_values[]={0,146,342,513,744};
+static int analog_read(uint8_t pin)
+{
+  for (byte j=0;j<2;j++)
+  {
+    if (analog_pins[j]!=pin) continue;
+    for (byte i=0;i<5;i++) if (key_closed(i+j*5)) return clamp_adc(analog_values[i]+adc_noise());
+  }
+  return clamp_adc(1023+adc_noise());
+}
+
+// Joystick on analog pins 0 and 1
+static int joystick_values[]={0,512,1023,0,512,1023};
+static int joystick_read(uint8_t pin)
+{
+  if (pin>1) return 512;
+  for (byte k=0;k<9;k++)
+  {
+    if (!key_closed(k)) continue;
+    byte d=(pin==0)?k/3:k%3;
+    return clamp_adc(joystick_values[pin*3+d]+adc_noise());
+  }
+  return clamp_adc(512+adc_noise());
+}
+
+// Digital encoders on pins 2 and 3. The legacy class reads B as bit 1, phi_rotary_encoders_d reads A as bit 1.
+static bool encoder_swap=false;
+static int encoder_read(uint8_t pin)
+{
+  byte s=encoder_state();
+  byte hi=(s>>1)&1, lo=s&1;
+  if (encoder_swap) {byte t=hi; hi=lo; lo=t;}
+  if (pin==2) return hi;
+  if (pin==3) return lo;
+  return HIGH;
+}
+
+static const byte encoder_bank_pins[]={2,3}; // A bank of one encoder on the same pins
+
+// Analog encoder on A0
+static byte encoder_a_values[]={151,128,0,80};
+static int encoder_a_read(uint8_t pin)
+{
+  if (pin!=A0) return 1023;
+  static const byte state_to_index[]={2,1,3,0};
+  return clamp_adc(encoder_a_values[state_to_index[encoder_state()]]*4+adc_noise());
+}
+
+// Serial keypad: a Stream that makes each real contact's key available one character time after the press.
+class bench_stream: public Stream{
+  public:
+  size_t next;
+  bench_stream(): next(0) {}
+  size_t write(uint8_t) {return 1;}
+  int available()
+  {
+    while ((next<contacts.size())&&!contacts[next].real) next++;
+    if (next>=contacts.size()) return 0;
+    return (contacts[next].t_start+1042<=host_time_us())?1:0; // One character at 9600 baud
+  }
+  int read()
+  {
+    if (!available()) return -1;
+    return 'a'+contacts[next++].key;
+  }
+  int peek()
+  {
+    if (!available()) return -1;
+    return 'a'+contacts[next].key;
+  }
+};
+
+/*
+Benchmark driver
+*/
+static char keypad_names[]="0123456789ABCDEFGHIJKLMNOPQRSTUV";
+static char joystick_names[]={'1','2','3','4',(char)NO_KEYs,'6','7','8','9'};
+static const byte joystick_keys[]={0,1,2,3,5,6,7,8};
+static char encoder_names[]={'U','D'};
+static bench_stream *serial_stream=0;
+
+struct bench_result{
+  unsigned long scans;
+  double wall_s;
+  unsigned long long target_us;
+  unsigned long long max_target_us;
+  std::vector<unsigned long> latencies;
+  std::vector<unsigned long> chord_latencies; // Keys that belong to the chord, with --chords
+  unsigned long false_events;
+  unsigned long missed_events;
+  unsigned long events;
+};
+
+static multiple_button_input *make_device(const std::string &name, bool &is_encoder, const char *&names, byte &n_keys, const byte *&valid)
+{
+  is_encoder=false;
+  names=keypad_names;
+  valid=0;
+  if (name=="phi_button_groups")
+  {
+    host_digital_read_hook=group_read;
+    n_keys=4;
+    return new phi_button_groups(keypad_names,(byte*)group_pins,4);
+  }
+  if (name=="phi_matrix_keypads")
+  {
+    host_digital_read_hook=matrix_read;
+    n_keys=16;
+    return new phi_matrix_keypads(keypad_names,(byte*)matrix_pins,4,4);
+  }
+  if (name=="phi_liudr_keypads")
+  {
+    liudr_shift_count=0;
+    liudr_columns=255;
+    liudr_pending=255;
+    host_digital_read_hook=liudr_read;
+    host_shift_out_hook=liudr_shift;
+    host_pin_write_hook=liudr_pin_write;
+    n_keys=16;
+    return new phi_liudr_keypads(keypad_names,(byte*)liudr_rows,17,15,16,2,8);
+  }
+  if (name=="phi_liudr_keypads_2")
+  {
+    host_analog_read_hook=liudr2_read;
+    n_keys=12;
+    return new phi_liudr_keypads_2(keypad_names,(byte*)liudr2_pins,A0,3,4,liudr2_values);
+  }
+  if (name=="phi_analog_keypads")
+  {
+    host_analog_read_hook=analog_read;
+    n_keys=10;
+    return new phi_analog_keypads(keypad_names,(byte*)analog_pins,analog_values,2,5);
+  }
+  if (name=="phi_joysticks")
+  {
+    host_analog_read_hook=joystick_read;
+    names=joystick_names;
+    valid=joystick_keys;
+    n_keys=8;
+    return new phi_joysticks(joystick_names,(byte*)analog_pins,joystick_values,100);
+  }
+  if (name=="phi_rotary_encoders")
+  {
+    encoder_swap=true;
+    host_digital_read_hook=encoder_read;
+    is_encoder=true;
+    names=encoder_names;
+    n_keys=2;
+    return new phi_rotary_encoders(encoder_names,2,3,12);
+  }
+  if (name=="phi_rotary_encoders_d")
+  {
+    encoder_swap=false;
+    host_digital_read_hook=encoder_read;
+    is_encoder=true;
+    names=encoder_names;
+    n_keys=2;
+    return new phi_rotary_encoders_d(encoder_names,2,3,12,EncoderType_NO);
+  }
+  if (name=="phi_rotary_encoders_a")
+  {
+    host_analog_read_hook=encoder_a_read;
+    is_encoder=true;
+    names=encoder_names;
+    n_keys=2;
+    return new phi_rotary_encoders_a(encoder_names,A0,encoder_a_values,12,EncoderType_NO);
+  }
+  if (name=="phi_rotary_encoder_banks")
+  {
+    encoder_swap=false;
+    host_digital_read_hook=encoder_read;
+    is_encoder=true;
+    names=encoder_names;
+    n_keys=2;
+    return new phi_rotary_encoder_banks(encoder_names,(byte*)encoder_bank_pins,1,12,EncoderType_NO);
+  }
+  if (name=="phi_serial_keypads")
+  {
+    serial_stream=new bench_stream;
+    names="abcdefghijklmnop";
+    n_keys=16;
+    return new phi_serial_keypads(serial_stream,9600);
+  }
+  return 0;
+}
+
+static bench_result run(const std::string &name, double debounce)
+{
+  bench_result r;
+  bool is_encoder;
+  const char *names;
+  byte n_keys=0;
+  const byte *valid;
+
+  host_reset();
+  contacts.clear();
+  active=0;
+  overlays.clear();
+  overlay=0;
+  rng_state=P.seed?P.seed:1;
+  multiple_button_input *dev=make_device(name,is_encoder,names,n_keys,valid);
+  if (P.clock_us)
+  {
+    multiple_button_input::set_clock(micros,1000);
+    multiple_button_input::set_debounce_us((unsigned long)(debounce*1000+0.5));
+  }
+  else
+  {
+    multiple_button_input::set_clock(millis,1);
+    dev->set_debounce((unsigned int)debounce);
+  }
+  phi_keypads *pad=dynamic_cast<phi_keypads*>(dev);
+  if (pad) pad->set_slice(P.slice);
+  static byte counters[32];
+  if (pad&&P.integrator[0]) pad->set_integrator(counters,32,P.integrator[0],P.integrator[1],P.integrator[2]);
+  static phi_chords chord[]={{(1UL<<0)|(1UL<<1),'!'}};
+  bool chords=pad&&P.chord_window;
+  if (chords) pad->set_chords(chord,1,P.chord_window);
+  if (is_encoder) make_encoder_schedule();
+  else make_key_schedule(n_keys,valid);
+
+  r.scans=0;
+  r.target_us=0;
+  r.max_target_us=0;
+  r.false_events=0;
+  r.missed_events=0;
+  r.events=0;
+  std::chrono::steady_clock::duration wall(0);
+  unsigned long long end=contacts.back().t_end+1000000;
+  size_t match=0; // First contact that may still be reported
+  while (host_time_us()<end)
+  {
+    unsigned long long t0=host_time_us();
+    std::chrono::steady_clock::time_point w0=std::chrono::steady_clock::now();
+    byte k=dev->getKey();
+    wall+=std::chrono::steady_clock::now()-w0;
+    unsigned long long now=host_time_us();
+    r.target_us+=now-t0;
+    if (now-t0>r.max_target_us) r.max_target_us=now-t0;
+    r.scans++;
+    if (k!=NO_KEY)
+    {
+      // A key counts for the latest real contact that started before now and is not reported yet. Anything else is a false event.
+      while ((match<contacts.size())&&((!contacts[match].real)||(contacts[match].detected)||(contacts[match].t_end+P.poll_us<t0))) match++;
+      if ((match<contacts.size())&&(contacts[match].t_start<=now)&&((byte)names[contacts[match].key]==k))
+      {
+        contacts[match].detected=true;
+        if (chords&&(chord[0].mask&(1UL<<contacts[match].key))) r.chord_latencies.push_back((unsigned long)(now-contacts[match].t_start));
+        else r.latencies.push_back((unsigned long)(now-contacts[match].t_start));
+      }
+      else r.false_events++;
+    }
+    host_advance_us(P.poll_us);
+  }
+  for (size_t i=0;i<contacts.size();i++)
+  {
+    if (!contacts[i].real) continue;
+    r.events++;
+    if (!contacts[i].detected) r.missed_events++;
+  }
+  r.wall_s=std::chrono::duration<double>(wall).count();
+  // multiple_button_input has no virtual destructor so devices are not deleted. Each run only leaks one small object.
+  serial_stream=0;
+  return r;
+}
+
+static unsigned long percentile(std::vector<unsigned long> v, unsigned int pct)
+{
+  if (v.empty()) return 0;
+  std::sort(v.begin(),v.end());
+  return v[(v.size()-1)*pct/100];
+}
+
+static void report(const std::string &name, double debounce, const bench_result &r)
+{
+  double scans_per_s=(r.wall_s>0)?r.scans/r.wall_s:0;
+  double target_per_scan=r.scans?(double)r.target_us/r.scans:0;
+  double false_rate=r.events?(double)r.false_events/r.events:0;
+  double missed_rate=r.events?(double)r.missed_events/r.events:0;
+  char integrator[16]="off";
+  if (P.integrator[0]) snprintf(integrator,sizeof(integrator),"%u/%u/%u",P.integrator[0],P.integrator[1],P.integrator[2]);
+  if (P.csv)
+  {
+    printf("%s,%g,%s,%u,%lu,%lu,%d,%lu,%lu,%lu,%lu,%.0f,%.1f,%llu,%lu,%lu,%lu,%lu,%.4f,%.4f,%lu,%s,%u,%lu\n",name.c_str(),debounce,P.clock_us?"us":"ms",P.slice,P.bounce_us,P.glitch_us,P.noise,P.jitter_us,P.poll_us,r.events,r.scans,scans_per_s,target_per_scan,r.max_target_us,
+      percentile(r.latencies,50),percentile(r.latencies,99),r.false_events,r.missed_events,false_rate,missed_rate,P.chatter_us,integrator,P.chord_window,percentile(r.chord_latencies,50));
+  }
+  else
+  {
+    printf("{\"class\":\"%s\",\"debounce_ms\":%g,\"clock\":\"%s\",\"slice\":%u,\"bounce_us\":%lu,\"glitch_us\":%lu,\"adc_noise\":%d,\"jitter_us\":%lu,\"poll_us\":%lu,\"events\":%lu,\"scans\":%lu,\"scans_per_sec\":%.0f,\"target_us_per_scan\":%.1f,\"max_target_us_per_scan\":%llu,"
+      "\"p50_latency_us\":%lu,\"p99_latency_us\":%lu,\"false_events\":%lu,\"missed_events\":%lu,\"false_rate\":%.4f,\"missed_rate\":%.4f,\"chatter_us\":%lu,\"integrator\":\"%s\",\"chord_window_ms\":%u,\"chord_key_p50_latency_us\":%lu}\n",name.c_str(),debounce,P.clock_us?"us":"ms",P.slice,P.bounce_us,P.glitch_us,P.noise,P.jitter_us,P.poll_us,r.events,r.scans,scans_per_s,target_per_scan,r.max_target_us,
+      percentile(r.latencies,50),percentile(r.latencies,99),r.false_events,r.missed_events,false_rate,missed_rate,P.chatter_us,integrator,P.chord_window,percentile(r.chord_latencies,50));
+  }
+}
+
+static bool arg_value(const char *arg, const char *opt, const char *&val)
+{
+  size_t n=strlen(opt);
+  if (strncmp(arg,opt,n)||(arg[n]!='=')) return false;
+  val=arg+n+1;
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  static const char *classes[]={"phi_rotary_encoders","phi_rotary_encoders_d","phi_rotary_encoders_a","phi_rotary_encoder_banks","phi_serial_keypads","phi_joysticks","phi_analog_keypads","phi_matrix_keypads","phi_button_groups","phi_liudr_keypads","phi_liudr_keypads_2"};
+  const char *v;
+  P.bounce_us=3000;
+  P.glitch_us=2000;
+  P.noise=4;
+  P.jitter_us=300;
+  P.step_us=2000;
+  P.poll_us=1000;
+  P.hold_ms=120;
+  P.gap_ms=80;
+  P.events=200;
+  P.seed=1;
+  P.slice=0;
+  P.chatter_us=0;
+  P.integrator[0]=P.integrator[1]=P.integrator[2]=0;
+  P.chord_window=0;
+  P.csv=false;
+  P.clock_us=false;
+  for (int i=1;i<argc;i++)
+  {
+    if (arg_value(argv[i],"--debounce",v))
+    {
+      P.debounce_ms.clear();
+      while (*v)
+      {
+        P.debounce_ms.push_back(strtod(v,(char**)&v));
+        if (*v==',') v++;
+        else if (*v) break;
+      }
+    }
+    else if (arg_value(argv[i],"--bounce-us",v)) P.bounce_us=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--glitch-us",v)) P.glitch_us=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--noise",v)) P.noise=atoi(v);
+    else if (arg_value(argv[i],"--jitter-us",v)) P.jitter_us=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--step-us",v)) P.step_us=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--poll-us",v)) P.poll_us=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--hold-ms",v)) P.hold_ms=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--gap-ms",v)) P.gap_ms=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--events",v)) P.events=(unsigned int)strtoul(v,0,10);
+    else if (arg_value(argv[i],"--seed",v)) P.seed=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--slice",v)) P.slice=(unsigned int)strtoul(v,0,10);
+    else if (arg_value(argv[i],"--chatter-us",v)) P.chatter_us=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--integrator",v))
+    {
+      unsigned int on=0, off=0, max=0;
+      if ((sscanf(v,"%u,%u,%u",&on,&off,&max)!=3)||(off>=on)||(on>max)||(max>integrator_count_max))
+      {
+        fprintf(stderr,"--integrator needs on,off,max with off<on<=max<=%u.\n",integrator_count_max);
+        return 1;
+      }
+      P.integrator[0]=on;
+      P.integrator[1]=off;
+      P.integrator[2]=max;
+    }
+    else if (arg_value(argv[i],"--chords",v)) P.chord_window=(unsigned int)strtoul(v,0,10);
+    else if (arg_value(argv[i],"--class",v)) P.only_class=v;
+    else if (arg_value(argv[i],"--clock",v)) P.clock_us=!strcmp(v,"us");
+    else if (!strcmp(argv[i],"--csv")) P.csv=true;
+    else
+    {
+      fprintf(stderr,"Unknown option %s. See the comment at the top of phi_interfaces_bench.cpp.\n",argv[i]);
+      return 1;
+    }
+  }
+  if (P.debounce_ms.empty())
+  {
+    P.debounce_ms.push_back(5);
+    P.debounce_ms.push_back(10);
+    P.debounce_ms.push_back(25);
+    P.debounce_ms.push_back(50);
+  }
+  if (P.events==0) P.events=1;
+
+  if (P.csv) printf("class,debounce_ms,clock,slice,bounce_us,glitch_us,adc_noise,jitter_us,poll_us,events,scans,scans_per_sec,target_us_per_scan,max_target_us_per_scan,p50_latency_us,p99_latency_us,false_events,missed_events,false_rate,missed_rate,chatter_us,integrator,chord_window_ms,chord_key_p50_latency_us\n");
+  for (size_t c=0;c<sizeof(classes)/sizeof(classes[0]);c++)
+  {
+    if (!P.only_class.empty()&&(P.only_class!=classes[c])) continue;
+    for (size_t d=0;d<P.debounce_ms.size();d++) report(classes[c],P.debounce_ms[d],run(classes[c],P.debounce_ms[d]));
+  }
+  return 0;
+}
@@ -0,0 +1,288 @@
+/** \file
+ *  \brief     Host benchmark for the phi_serial_keypads path under burst loads.
+ *  \details   A sender writes bursts of key presses into a host_ring_streams line paced at a baud rate on the virtual clock, and a receiving phi_serial_keypads calls getKey() once per main loop, the way a sketch does.
+ *  In raw mode each key is one byte. In framed mode the sender queues a press and a release per key with queue_event() and sends each burst with flush_events(), see phi_serial_keypads::set_frame_buffers.
+ *  For every mode requested, one line is printed with keys per second through getKey() (PC time spent in getKey only), keys per second on the target (virtual time from the first burst to the last key), bytes per key on the line, and p50/p99/max latency from the burst being sent to getKey() returning each key.
+ *  Output is JSON lines by default or CSV with --csv.
+ *
+ *  Build and run from the library folder:
+ *
+ *  g++ -O2 -DARDUINO=10605 -I extras/host -I . extras/benchmark/phi_serial_bench.cpp extras/host/host_arduino.cpp extras/host/host_streams.cpp phi_interfaces.cpp -o phi_serial_bench
+ *
+ *  ./phi_serial_bench --mode=raw,framed --baud=115200 --burst=8
+ *
+ *  Options (defaults in brackets):
+ *  --mode=list       raw and/or framed [raw,framed]
+ *  --baud=n          line speed, 10 bits per character [115200]
+ *  --burst=n         keys per burst [8]
+ *  --bursts=n        bursts per run [200]
+ *  --burst-gap-ms=n  time between bursts [50]
+ *  --poll-us=n       main loop period, time between getKey() calls [1000]
+ *  --drain           call getKey() until it returns NO_KEY on every loop instead of once
+ *  --frame-events=n  events per frame in framed mode, up to serial_frame_events_max [16]
+ *  --ring=n          receive ring size in framed mode, up to 255 [128]
+ *  --record=file     also save the bytes sent to a file, to replay later
+ *  --replay=file     replay a saved file into the receiver instead of sending bursts. Latency is not measured.
+ *  --csv             CSV output instead of JSON lines
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#include <Arduino.h>
+#include <host_streams.h>
+#include <phi_interfaces.h>
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+struct bench_params{
+  std::vector<std::string> modes;
+  unsigned long baud;
+  unsigned int burst;
+  unsigned int bursts;
+  unsigned long burst_gap_ms;
+  unsigned long poll_us;
+  bool drain;
+  unsigned int frame_events;
+  unsigned int ring;
+  std::string record;
+  std::string replay;
+  bool csv;
+};
+
+static bench_params P;
+
+// Sends into the line and, with --record, into a file too.
+class tee_stream: public Stream{
+  public:
+  Stream *line;
+  FILE *file;
+  unsigned long bytes;
+  tee_stream(Stream *l, FILE *f): line(l), file(f), bytes(0) {}
+  size_t write(uint8_t c)
+  {
+    bytes++;
+    if (file) fputc(c,file);
+    return line->write(c);
+  }
+  using Print::write;
+  int available() {return 0;}
+  int read() {return -1;}
+  int peek() {return -1;}
+};
+
+struct bench_result{
+  unsigned long keys;
+  unsigned long wrong_keys;
+  unsigned long lost_keys;
+  unsigned long bytes;
+  unsigned long calls;
+  double wall_s;
+  unsigned long long span_us;
+  std::vector<unsigned long> latencies;
+};
+
+static const char key_names[]="abcdefghijklmnop";
+
+static bench_result run(const std::string &mode)
+{
+  bench_result r;
+  bool framed=(mode=="framed");
+  host_reset();
+  multiple_button_input::set_clock(millis,1);
+  host_ring_streams line(1<<16,P.baud);
+  host_replay_streams replay(P.baud);
+  FILE *rec=0;
+  if (!P.record.empty()) rec=fopen(P.record.c_str(),"wb");
+  tee_stream out(&line,rec);
+
+  Stream *rx_port=&line;
+  if (!P.replay.empty())
+  {
+    if (!replay.open(P.replay.c_str()))
+    {
+      fprintf(stderr,"Can't read %s\n",P.replay.c_str());
+      exit(1);
+    }
+    rx_port=&replay;
+  }
+  phi_serial_keypads sender(&out,P.baud);
+  phi_serial_keypads receiver(rx_port,P.baud);
+  std::vector<byte> tx(serial_frame_bytes(P.frame_events));
+  std::vector<byte> rx(P.ring);
+  if (framed)
+  {
+    sender.set_frame_buffers(0,0,&tx[0],tx.size());
+    receiver.set_frame_buffers(&rx[0],rx.size(),0,0);
+  }
+
+  std::deque<std::pair<byte,unsigned long long> > sent; // Keys in flight and when their burst was sent
+  r.keys=0;
+  r.wrong_keys=0;
+  r.lost_keys=0;
+  r.calls=0;
+  std::chrono::steady_clock::duration wall(0);
+  unsigned long long t_first=host_time_us();
+  unsigned long long t_last=t_first;
+  unsigned long long next_burst=t_first;
+  unsigned int bursts=0;
+  unsigned int n_key=0;
+  unsigned long long idle_since=t_first;
+  while (1)
+  {
+    unsigned long long now=host_time_us();
+    if (P.replay.empty()&&(bursts<P.bursts)&&(now>=next_burst))
+    {
+      for (unsigned int i=0;i<P.burst;i++)
+      {
+        byte k=key_names[n_key++%16];
+        if (framed)
+        {
+          sender.queue_event(k,buttons_pressed);
+          sender.queue_event(k,buttons_released);
+        }
+        else out.write(k);
+        sent.push_back(std::make_pair(k,now));
+      }
+      if (framed) sender.flush_events();
+      bursts++;
+      next_burst+=P.burst_gap_ms*1000;
+    }
+    byte k;
+    do
+    {
+      std::chrono::steady_clock::time_point w0=std::chrono::steady_clock::now();
+      k=receiver.getKey();
+      wall+=std::chrono::steady_clock::now()-w0;
+      r.calls++;
+      if (k==NO_KEY) break;
+      r.keys++;
+      t_last=host_time_us();
+      idle_since=t_last;
+      if (!P.replay.empty()) continue;
+      while ((!sent.empty())&&(sent.front().first!=k)) // Keys skipped over were lost on the way.
+      {
+        sent.pop_front();
+        r.lost_keys++;
+      }
+      if (sent.empty()) r.wrong_keys++;
+      else
+      {
+        r.latencies.push_back((unsigned long)(t_last-sent.front().second));
+        sent.pop_front();
+      }
+    } while (P.drain);
+    bool sending=P.replay.empty()?(bursts<P.bursts):(!replay.done());
+    if ((!sending)&&(host_time_us()-idle_since>1000000)) break; // Nothing more for a second.
+    host_advance_us(P.poll_us);
+  }
+  r.lost_keys+=sent.size();
+  r.bytes=P.replay.empty()?out.bytes:(unsigned long)replay.length();
+  r.wall_s=std::chrono::duration<double>(wall).count();
+  r.span_us=t_last-t_first;
+  if (rec) fclose(rec);
+  return r;
+}
+
+static unsigned long percentile(std::vector<unsigned long> v, unsigned int pct)
+{
+  if (v.empty()) return 0;
+  std::sort(v.begin(),v.end());
+  return v[(v.size()-1)*pct/100];
+}
+
+static void report(const std::string &mode, const bench_result &r)
+{
+  double keys_per_s=(r.wall_s>0)?r.keys/r.wall_s:0;
+  double target_keys_per_s=r.span_us?r.keys*1e6/r.span_us:0;
+  double bytes_per_key=r.keys?(double)r.bytes/r.keys:0;
+  unsigned long max_latency=r.latencies.empty()?0:*std::max_element(r.latencies.begin(),r.latencies.end());
+  if (P.csv)
+  {
+    printf("%s,%lu,%u,%u,%lu,%lu,%d,%u,%u,%lu,%lu,%lu,%lu,%.0f,%.1f,%.2f,%lu,%lu,%lu\n",mode.c_str(),P.baud,P.burst,P.bursts,P.burst_gap_ms,P.poll_us,P.drain?1:0,P.frame_events,P.ring,r.keys,r.lost_keys,r.wrong_keys,r.calls,keys_per_s,target_keys_per_s,bytes_per_key,
+      percentile(r.latencies,50),percentile(r.latencies,99),max_latency);
+  }
+  else
+  {
+    printf("{\"mode\":\"%s\",\"baud\":%lu,\"burst\":%u,\"bursts\":%u,\"burst_gap_ms\":%lu,\"poll_us\":%lu,\"drain\":%s,\"frame_events\":%u,\"ring\":%u,\"keys\":%lu,\"lost_keys\":%lu,\"wrong_keys\":%lu,\"getkey_calls\":%lu,\"keys_per_sec\":%.0f,\"target_keys_per_sec\":%.1f,\"bytes_per_key\":%.2f,"
+      "\"p50_latency_us\":%lu,\"p99_latency_us\":%lu,\"max_latency_us\":%lu}\n",mode.c_str(),P.baud,P.burst,P.bursts,P.burst_gap_ms,P.poll_us,P.drain?"true":"false",P.frame_events,P.ring,r.keys,r.lost_keys,r.wrong_keys,r.calls,keys_per_s,target_keys_per_s,bytes_per_key,
+      percentile(r.latencies,50),percentile(r.latencies,99),max_latency);
+  }
+}
+
+static bool arg_value(const char *arg, const char *opt, const char *&val)
+{
+  size_t n=strlen(opt);
+  if (strncmp(arg,opt,n)||(arg[n]!='=')) return false;
+  val=arg+n+1;
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  const char *v;
+  P.baud=115200;
+  P.burst=8;
+  P.bursts=200;
+  P.burst_gap_ms=50;
+  P.poll_us=1000;
+  P.drain=false;
+  P.frame_events=serial_frame_events_max;
+  P.ring=128;
+  P.csv=false;
+  for (int i=1;i<argc;i++)
+  {
+    if (arg_value(argv[i],"--mode",v))
+    {
+      P.modes.clear();
+      while (*v)
+      {
+        const char *e=strchr(v,',');
+        if (!e) e=v+strlen(v);
+        P.modes.push_back(std::string(v,e-v));
+        v=*e?e+1:e;
+      }
+    }
+    else if (arg_value(argv[i],"--baud",v)) P.baud=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--burst",v)) P.burst=(unsigned int)strtoul(v,0,10);
+    else if (arg_value(argv[i],"--bursts",v)) P.bursts=(unsigned int)strtoul(v,0,10);
+    else if (arg_value(argv[i],"--burst-gap-ms",v)) P.burst_gap_ms=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--poll-us",v)) P.poll_us=strtoul(v,0,10);
+    else if (arg_value(argv[i],"--frame-events",v)) P.frame_events=(unsigned int)strtoul(v,0,10);
+    else if (arg_value(argv[i],"--ring",v)) P.ring=(unsigned int)strtoul(v,0,10);
+    else if (arg_value(argv[i],"--record",v)) P.record=v;
+    else if (arg_value(argv[i],"--replay",v)) P.replay=v;
+    else if (!strcmp(argv[i],"--drain")) P.drain=true;
+    else if (!strcmp(argv[i],"--csv")) P.csv=true;
+    else
+    {
+      fprintf(stderr,"Unknown option %s. See the comment at the top of phi_serial_bench.cpp.\n",argv[i]);
+      return 1;
+    }
+  }
+  if (P.modes.empty())
+  {
+    P.modes.push_back("raw");
+    P.modes.push_back("framed");
+  }
+  if (P.burst==0) P.burst=1;
+  if (P.poll_us==0) P.poll_us=1;
+  if ((P.frame_events==0)||(P.frame_events>serial_frame_events_max)) P.frame_events=serial_frame_events_max;
+  if (P.ring<serial_frame_bytes(2)) P.ring=serial_frame_bytes(2);
+  if (P.ring>255) P.ring=255;
+
+  if (P.csv) printf("mode,baud,burst,bursts,burst_gap_ms,poll_us,drain,frame_events,ring,keys,lost_keys,wrong_keys,getkey_calls,keys_per_sec,target_keys_per_sec,bytes_per_key,p50_latency_us,p99_latency_us,max_latency_us\n");
+  for (size_t m=0;m<P.modes.size();m++)
+  {
+    if ((P.modes[m]!="raw")&&(P.modes[m]!="framed"))
+    {
+      fprintf(stderr,"Unknown mode %s\n",P.modes[m].c_str());
+      return 1;
+    }
+    report(P.modes[m],run(P.modes[m]));
+  }
+  return 0;
+}
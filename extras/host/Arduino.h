@@ -0,0 +1,120 @@
+/** \file
+ *  \brief     Host (PC) stand-in for the Arduino core, used to build phi_interfaces off-target.
+ *  \details   This header provides just enough of the Arduino API for phi_interfaces.cpp to compile and run on a PC.
+ *  Pins are kept in a pin image (mode and output level of each pin). Reads go through hooks so a simulated panel can decide what each input pin sees, depending on which column pins the library is driving.
+ *  Time is virtual. millis() and micros() return a clock that only moves when host_advance_us() is called or the library calls delay(). This makes runs repeatable and lets a benchmark measure latency in target time instead of PC time.
+ *  host_use_real_clock() switches to the PC's clock instead, for test rigs that run the library in real time, see host_shm.h.
+ *  Build with the same define the Arduino IDE passes, for example: g++ -DARDUINO=10605 -I extras/host -I . ...
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#ifndef host_Arduino_h
+#define host_Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEFAULT 1
+#define MSBFIRST 1
+#define LSBFIRST 0
+
+#define B0 0
+#define B00 0
+#define B1 1
+#define B01 1
+#define B10 2
+#define B11 3
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+
+#define noInterrupts()
+#define interrupts()
+
+#define host_pin_count 64 ///< Number of pins in the host pin image.
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/// Pin image shared by the library and the simulated hardware.
+struct host_pin_image{
+  uint8_t mode[host_pin_count];   ///< Last mode set with pinMode(): INPUT, OUTPUT or INPUT_PULLUP.
+  uint8_t level[host_pin_count];  ///< Last level set with digitalWrite(). On an INPUT pin HIGH means the pull-up is enabled.
+  int analog[host_pin_count];     ///< Value returned by analogRead() when no analog hook is installed.
+};
+
+extern host_pin_image host_pins;                                  ///< The pin image.
+extern int (*host_digital_read_hook)(uint8_t pin);                ///< If set, digitalRead() returns this instead of the pin image.
+extern int (*host_analog_read_hook)(uint8_t pin);                 ///< If set, analogRead() returns this instead of host_pins.analog.
+extern void (*host_shift_out_hook)(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val); ///< Called on every shiftOut().
+extern void (*host_pin_write_hook)(uint8_t pin);                  ///< Called after pinMode() or digitalWrite() changes a pin.
+extern unsigned long host_analog_read_us;                         ///< Virtual time one analogRead() takes. Defaults to 112us like an AVR at 16MHz.
+
+void host_advance_us(unsigned long us);   ///< Advances the virtual clock.
+unsigned long long host_time_us();        ///< Returns the virtual clock without wrapping.
+void host_reset();                        ///< Clears the pin image, hooks and clock.
+void host_use_real_clock(bool on);        ///< With on, the clock follows the PC's monotonic clock from now on and delay() sleeps, for running in real time against another process or thread.
+
+/// Minimal Print class. Only the members phi_interfaces and its examples use are provided.
+class Print{
+  public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c)=0;
+  size_t write(const char *str);
+  virtual size_t write(const uint8_t *buf, size_t n);
+  size_t print(const char *str);
+  size_t print(long n);
+  size_t print(unsigned long n);
+  size_t print(int n) {return print((long)n);}
+  size_t print(unsigned int n) {return print((unsigned long)n);}
+  size_t print(char c) {return write((uint8_t)c);}
+  size_t println(const char *str);
+  size_t println(long n);
+  size_t println(unsigned long n);
+  size_t println(int n) {return println((long)n);}
+  size_t println(unsigned int n) {return println((unsigned long)n);}
+  size_t println();
+};
+
+/// Minimal Stream class.
+class Stream: public Print{
+  public:
+  virtual int available()=0;
+  virtual int read()=0;
+  virtual int peek()=0;
+  virtual void flush() {}
+};
+
+#endif
@@ -0,0 +1,174 @@
+/** \file
+ *  \brief     Host (PC) implementation of the Arduino stand-in declared in extras/host/Arduino.h.
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#include <Arduino.h>
+#include <stdio.h>
+#include <time.h>
+
+host_pin_image host_pins;
+int (*host_digital_read_hook)(uint8_t pin)=0;
+int (*host_analog_read_hook)(uint8_t pin)=0;
+void (*host_shift_out_hook)(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)=0;
+void (*host_pin_write_hook)(uint8_t pin)=0;
+unsigned long host_analog_read_us=112;
+
+static unsigned long long host_clock_us=0;
+static bool host_real_clock=false;
+static unsigned long long host_real_start_us=0; ///< Monotonic time the real clock was started at, less the virtual time reached by then.
+
+static unsigned long long monotonic_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (unsigned long long)ts.tv_sec*1000000ULL+ts.tv_nsec/1000;
+}
+
+static void sleep_us(unsigned long long us)
+{
+  struct timespec ts;
+  ts.tv_sec=us/1000000ULL;
+  ts.tv_nsec=(us%1000000ULL)*1000;
+  while (nanosleep(&ts,&ts)!=0);
+}
+
+void host_advance_us(unsigned long us)
+{
+  if (host_real_clock) sleep_us(us);
+  else host_clock_us+=us;
+}
+
+unsigned long long host_time_us()
+{
+  if (host_real_clock) return monotonic_us()-host_real_start_us;
+  return host_clock_us;
+}
+
+void host_use_real_clock(bool on)
+{
+  if (on==host_real_clock) return;
+  if (on) host_real_start_us=monotonic_us()-host_clock_us; // Carry on from the virtual time so the clock never jumps back.
+  else host_clock_us=host_time_us();
+  host_real_clock=on;
+}
+
+void host_reset()
+{
+  memset(&host_pins,0,sizeof(host_pins));
+  host_digital_read_hook=0;
+  host_analog_read_hook=0;
+  host_shift_out_hook=0;
+  host_pin_write_hook=0;
+  host_analog_read_us=112;
+  host_clock_us=0;
+  host_real_clock=false;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin>=host_pin_count) return;
+  host_pins.mode[pin]=mode;
+  if (mode==INPUT_PULLUP) host_pins.level[pin]=HIGH;
+  if (host_pin_write_hook) host_pin_write_hook(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if (pin>=host_pin_count) return;
+  host_pins.level[pin]=(val!=LOW);
+  if (host_pin_write_hook) host_pin_write_hook(pin);
+}
+
+int digitalRead(uint8_t pin)
+{
+  if (host_digital_read_hook) return host_digital_read_hook(pin);
+  if (pin>=host_pin_count) return LOW;
+  return host_pins.level[pin];
+}
+
+int analogRead(uint8_t pin)
+{
+  if (!host_real_clock) host_clock_us+=host_analog_read_us; // The real clock already counts the time this takes.
+  if (host_analog_read_hook) return host_analog_read_hook(pin);
+  if (pin>=host_pin_count) return 0;
+  return host_pins.analog[pin];
+}
+
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)
+{
+  if (host_shift_out_hook) host_shift_out_hook(dataPin, clockPin, bitOrder, val);
+}
+
+unsigned long millis()
+{
+  return (unsigned long)(host_time_us()/1000);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)host_time_us();
+}
+
+void delay(unsigned long ms)
+{
+  host_advance_us(ms*1000UL);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  host_advance_us(us);
+}
+
+size_t Print::write(const char *str)
+{
+  size_t n=0;
+  while (*str) n+=write((uint8_t)*str++);
+  return n;
+}
+
+size_t Print::write(const uint8_t *buf, size_t n)
+{
+  size_t sent=0;
+  while (n--) sent+=write(*buf++);
+  return sent;
+}
+
+size_t Print::print(const char *str)
+{
+  return write(str);
+}
+
+size_t Print::print(long n)
+{
+  char buf[24];
+  snprintf(buf,sizeof(buf),"%ld",n);
+  return write(buf);
+}
+
+size_t Print::print(unsigned long n)
+{
+  char buf[24];
+  snprintf(buf,sizeof(buf),"%lu",n);
+  return write(buf);
+}
+
+size_t Print::println(const char *str)
+{
+  return print(str)+println();
+}
+
+size_t Print::println(long n)
+{
+  return print(n)+println();
+}
+
+size_t Print::println(unsigned long n)
+{
+  return print(n)+println();
+}
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
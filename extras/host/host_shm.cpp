@@ -0,0 +1,234 @@
+/** \file
+ *  \brief     Host (PC) shared-memory pin backend and scanner thread declared in extras/host/host_shm.h.
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#include <host_shm.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <time.h>
+
+host_shm_pins *host_shm_pins::attached=0;
+
+/*
+Shared pin image
+*/
+host_shm_pins::host_shm_pins()
+{
+  img=0;
+}
+
+host_shm_pins::~host_shm_pins()
+{
+  close();
+}
+
+static host_shm_images *map_image(const char *name, int flags)
+{
+  int fd=shm_open(name,flags,0600);
+  if (fd<0) return 0;
+  if ((flags&O_CREAT)&&(ftruncate(fd,sizeof(host_shm_images))<0))
+  {
+    ::close(fd);
+    return 0;
+  }
+  void *p=mmap(0,sizeof(host_shm_images),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  ::close(fd); // The mapping keeps the object open.
+  return (p==MAP_FAILED)?0:(host_shm_images *)p;
+}
+
+bool host_shm_pins::create(const char *name)
+{
+  close();
+  img=map_image(name,O_RDWR|O_CREAT);
+  if (!img) return false;
+  img->magic=0; // Readers wait for the magic number, so clear it while the image is being reset.
+  for (byte i=0;i<host_pin_count;i++)
+  {
+    img->drive[i]=host_shm_float;
+    img->contacts[i]=0;
+    img->analog[i]=0;
+    img->mode[i]=INPUT;
+    img->level[i]=LOW;
+  }
+  img->shift_count=0;
+  img->shift_value=0;
+  img->pins=host_pin_count;
+  __atomic_store_n(&img->magic,(uint32_t)host_shm_magic,__ATOMIC_RELEASE);
+  return true;
+}
+
+bool host_shm_pins::open(const char *name)
+{
+  close();
+  img=map_image(name,O_RDWR);
+  if (!img) return false;
+  if ((__atomic_load_n(&img->magic,__ATOMIC_ACQUIRE)!=host_shm_magic)||(img->pins!=host_pin_count))
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void host_shm_pins::close()
+{
+  if (!img) return;
+  if (attached==this) detach();
+  munmap(img,sizeof(host_shm_images));
+  img=0;
+}
+
+void host_shm_pins::remove(const char *name)
+{
+  shm_unlink(name);
+}
+
+void host_shm_pins::attach()
+{
+  if (!img) return;
+  attached=this;
+  for (byte i=0;i<host_pin_count;i++) pin_written(i); // Publish what the library set up before attaching.
+  host_digital_read_hook=digital_read;
+  host_analog_read_hook=analog_read;
+  host_pin_write_hook=pin_written;
+  host_shift_out_hook=shifted_out;
+}
+
+void host_shm_pins::detach()
+{
+  if (attached!=this) return;
+  host_digital_read_hook=0;
+  host_analog_read_hook=0;
+  host_pin_write_hook=0;
+  host_shift_out_hook=0;
+  attached=0;
+}
+
+void host_shm_pins::set_contact(byte a, byte b, bool closed)
+{
+  if ((!img)||(a>=host_pin_count)||(b>=host_pin_count)) return;
+  if (closed)
+  {
+    img->contacts[a]|=1ULL<<b;
+    img->contacts[b]|=1ULL<<a;
+  }
+  else
+  {
+    img->contacts[a]&=~(1ULL<<b);
+    img->contacts[b]&=~(1ULL<<a);
+  }
+}
+
+/**
+ * A pin the stand-in drives reads what it drives, and an output pin reads its own level. Otherwise any output pin connected to it through a closed switch decides, LOW winning over HIGH like open-drain columns.
+ * A pin nothing reaches reads HIGH with its pull-up enabled and LOW floating.
+*/
+int host_shm_pins::digital_read(uint8_t pin)
+{
+  if (pin>=host_pin_count) return LOW;
+  host_shm_images *img=attached->img;
+  byte d=img->drive[pin];
+  if (d!=host_shm_float) return d?HIGH:LOW;
+  if (host_pins.mode[pin]==OUTPUT) return host_pins.level[pin];
+  uint64_t c=img->contacts[pin];
+  int level=-1;
+  for (byte j=0;c;j++,c>>=1)
+  {
+    if (!(c&1)) continue;
+    if (host_pins.mode[j]!=OUTPUT) continue;
+    if (host_pins.level[j]==LOW) return LOW;
+    level=HIGH;
+  }
+  if (level>=0) return level;
+  if ((host_pins.mode[pin]==INPUT_PULLUP)||host_pins.level[pin]) return HIGH;
+  return LOW;
+}
+
+int host_shm_pins::analog_read(uint8_t pin)
+{
+  if (pin>=host_pin_count) return 0;
+  return attached->img->analog[pin];
+}
+
+void host_shm_pins::pin_written(uint8_t pin)
+{
+  if (pin>=host_pin_count) return;
+  host_shm_images *img=attached->img;
+  img->mode[pin]=host_pins.mode[pin];
+  img->level[pin]=host_pins.level[pin];
+}
+
+void host_shm_pins::shifted_out(uint8_t, uint8_t, uint8_t, uint8_t val)
+{
+  host_shm_images *img=attached->img;
+  img->shift_value=val;
+  __atomic_add_fetch(&img->shift_count,1,__ATOMIC_RELEASE); // The value is in place before the count moves.
+}
+
+/*
+Scanner thread
+*/
+host_scan_threads::host_scan_threads():running(false),dropped(0),passes(0),late(0)
+{
+  devs=0;
+  dev_count=0;
+  period=1000;
+}
+
+host_scan_threads::~host_scan_threads()
+{
+  stop();
+}
+
+bool host_scan_threads::start(multiple_button_input **devices, byte count, unsigned long period_us)
+{
+  if (running.load()) return false;
+  devs=devices;
+  dev_count=count;
+  period=period_us?period_us:1;
+  host_use_real_clock(true);
+  running.store(true);
+  worker=std::thread(&host_scan_threads::run,this);
+  return true;
+}
+
+void host_scan_threads::stop()
+{
+  if (!running.exchange(false)) return;
+  if (worker.joinable()) worker.join();
+}
+
+void host_scan_threads::run()
+{
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC,&next);
+  while (running.load(std::memory_order_relaxed))
+  {
+    for (byte i=0;i<dev_count;i++)
+    {
+      byte key=devs[i]->getKey();
+      if (key==NO_KEY) continue;
+      host_key_events ev;
+      ev.key=key;
+      ev.status=devs[i]->get_status();
+      ev.device=i;
+      ev.t_us=host_time_us();
+      if (!queue.push(ev)) dropped.fetch_add(1,std::memory_order_relaxed);
+    }
+    passes.fetch_add(1,std::memory_order_relaxed);
+    next.tv_nsec+=(long)(period%1000000UL)*1000;
+    next.tv_sec+=period/1000000UL+next.tv_nsec/1000000000L;
+    next.tv_nsec%=1000000000L;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    if ((now.tv_sec>next.tv_sec)||((now.tv_sec==next.tv_sec)&&(now.tv_nsec>next.tv_nsec))) // A whole period late. Skip ahead instead of bursting to catch up.
+    {
+      late.fetch_add(1,std::memory_order_relaxed);
+      next=now;
+      continue;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&next,0);
+  }
+}
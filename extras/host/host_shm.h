@@ -0,0 +1,128 @@
+/** \file
+ *  \brief     Host (PC) backend that reads pins from a shared-memory image written by another process, and a scanner thread for it.
+ *  \details   This lets a desktop test rig run the library in real time against a panel simulated by a separate process.
+ *  host_shm_pins maps a POSIX shared-memory object holding a host_shm_images. The stand-in process creates it and writes what the panel does: the level it drives onto a pin, switches closed between pins and ADC readings.
+ *  The process running the library opens the same object and calls attach(). From then on digitalRead(), analogRead(), pinMode(), digitalWrite() and shiftOut() in the Arduino stand-in go through the image, and the library's outputs are published in it for the stand-in to see.
+ *  A closed switch between two pins is a contact, not a level, so a matrix keypad works without the stand-in having to follow the column being driven: reading a row returns the level of any output pin it touches, as a real switch would.
+ *  Readings that depend on the library's outputs in other ways, such as the analog sense pin of phi_liudr_keypads_2 or the shift register of phi_liudr_keypads, are not modelled.
+ *  host_scan_threads calls getKey() on a list of devices from a thread of its own at a fixed period on the real clock, and hands every key to the main thread through a host_spsc_queues that needs no locks.
+ *
+ *  Build with -pthread, for example:
+ *
+ *  g++ -O2 -pthread -DARDUINO=10605 -I extras/host -I . extras/host/host_shm_rig.cpp extras/host/host_shm.cpp extras/host/host_arduino.cpp phi_interfaces.cpp -o host_shm_rig
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#ifndef host_shm_h
+#define host_shm_h
+
+#include <Arduino.h>
+#include <phi_interfaces.h>
+#include <atomic>
+#include <thread>
+
+#define host_shm_magic 0x31696870UL  ///< "phi1", marks an initialized image.
+#define host_shm_float 255           ///< Drive value meaning the stand-in leaves the pin alone.
+
+/// Layout of the shared image. Each field has one writer, either the stand-in or the library.
+struct host_shm_images{
+  uint32_t magic;                               ///< host_shm_magic once the stand-in has initialized the image.
+  uint32_t pins;                                ///< Number of pins, host_pin_count.
+  volatile uint8_t drive[host_pin_count];       ///< Stand-in: LOW or HIGH forced onto the pin, or host_shm_float.
+  volatile uint64_t contacts[host_pin_count];   ///< Stand-in: bit j of entry i is set while a switch connects pin i to pin j.
+  volatile int32_t analog[host_pin_count];      ///< Stand-in: what analogRead() returns.
+  volatile uint8_t mode[host_pin_count];        ///< Library: mode set with pinMode().
+  volatile uint8_t level[host_pin_count];       ///< Library: level set with digitalWrite().
+  volatile uint32_t shift_count;                ///< Library: number of shiftOut() calls.
+  volatile uint8_t shift_value;                 ///< Library: last byte shifted out.
+};
+
+/// Shared pin image in a POSIX shared-memory object.
+class host_shm_pins{
+  public:
+  host_shm_pins();
+  ~host_shm_pins();
+  bool create(const char *name);  ///< Creates or resets the object as the stand-in. All pins float and read 0 on the ADC.
+  bool open(const char *name);    ///< Opens an object made by the stand-in. Returns false if it doesn't exist yet.
+  void close();                   ///< Detaches and unmaps. The object stays until remove().
+  static void remove(const char *name); ///< Deletes the object.
+  host_shm_images *image() {return img;} ///< The mapped image, or 0.
+  void attach();                  ///< Routes the Arduino stand-in's pin calls through this image. Only one image is attached at a time.
+  void detach();                  ///< Goes back to the plain pin image.
+  void set_contact(byte a, byte b, bool closed); ///< Stand-in: closes or opens a switch between two pins.
+
+  private:
+  host_shm_images *img;
+  static host_shm_pins *attached;
+  static int digital_read(uint8_t pin);
+  static int analog_read(uint8_t pin);
+  static void pin_written(uint8_t pin);
+  static void shifted_out(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+};
+
+/// Single-producer single-consumer queue of n-1 entries. One thread pushes and one thread pops, without locks.
+template<class T, size_t n> class host_spsc_queues{
+  public:
+  host_spsc_queues():head(0),tail(0) {}
+/// Adds an entry. Only the producer calls this. Returns false if the queue is full.
+  bool push(const T &v)
+  {
+    size_t h=head.load(std::memory_order_relaxed);
+    size_t next=(h+1)%n;
+    if (next==tail.load(std::memory_order_acquire)) return false;
+    buf[h]=v;
+    head.store(next,std::memory_order_release); // The entry is written before the consumer can see it.
+    return true;
+  }
+/// Takes the oldest entry. Only the consumer calls this. Returns false if the queue is empty.
+  bool pop(T &v)
+  {
+    size_t t=tail.load(std::memory_order_relaxed);
+    if (t==head.load(std::memory_order_acquire)) return false;
+    v=buf[t];
+    tail.store((t+1)%n,std::memory_order_release); // The entry is copied before the producer can reuse it.
+    return true;
+  }
+  bool empty() const {return head.load(std::memory_order_acquire)==tail.load(std::memory_order_acquire);}
+
+  private:
+  T buf[n];
+  alignas(64) std::atomic<size_t> head; ///< Written by the producer only.
+  alignas(64) std::atomic<size_t> tail; ///< Written by the consumer only.
+};
+
+/// One key found by host_scan_threads.
+struct host_key_events{
+  byte key;                   ///< Key name returned by getKey().
+  byte status;                ///< get_status() right after getKey().
+  byte device;                ///< Index of the device in the list given to start().
+  unsigned long long t_us;    ///< host_time_us() when getKey() returned the key.
+};
+
+#define host_scan_queue_size 256    ///< Entries in the host_scan_threads queue.
+
+/// Thread that polls devices at a fixed period and queues their keys.
+class host_scan_threads{
+  public:
+  host_scan_threads();
+  ~host_scan_threads();
+/// Starts polling devices[0] to devices[count-1] every period_us on the real clock. Turns on host_use_real_clock(). Returns false if already running.
+  bool start(multiple_button_input **devices, byte count, unsigned long period_us);
+  void stop();                                ///< Stops and joins the thread. Keys already queued can still be popped.
+  bool pop(host_key_events &ev) {return queue.pop(ev);} ///< Takes the oldest key. Call from one thread only.
+  unsigned long lost() const {return dropped.load(std::memory_order_relaxed);} ///< Keys thrown away because the queue was full.
+  unsigned long scans() const {return passes.load(std::memory_order_relaxed);} ///< Polling passes so far.
+  unsigned long overruns() const {return late.load(std::memory_order_relaxed);} ///< Passes that started a whole period late.
+
+  private:
+  void run();
+  multiple_button_input **devs;
+  byte dev_count;
+  unsigned long period;
+  std::thread worker;
+  std::atomic<bool> running;
+  std::atomic<unsigned long> dropped, passes, late;
+  host_spsc_queues<host_key_events,host_scan_queue_size> queue;
+};
+
+#endif
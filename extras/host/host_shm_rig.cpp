@@ -0,0 +1,208 @@
+/** \file
+ *  \brief     Two-process test rig for the shared-memory pin backend in extras/host/host_shm.h.
+ *  \details   Run one copy as the panel stand-in and another as the firmware side. The panel creates the shared image and takes commands on its input. The firmware side attaches to the image, polls a matrix keypad, a rotary encoder and a button group from a host_scan_threads thread and prints every key the thread queues.
+ *
+ *  Build from the library folder:
+ *
+ *  g++ -O2 -pthread -DARDUINO=10605 -I extras/host -I . extras/host/host_shm_rig.cpp extras/host/host_shm.cpp extras/host/host_arduino.cpp phi_interfaces.cpp -o host_shm_rig
+ *
+ *  ./host_shm_rig panel            (in one terminal, then type commands)
+ *
+ *  ./host_shm_rig scan --seconds=30 (in another)
+ *
+ *  Panel commands, one per line:
+ *  key n [ms]        hold matrix key n (0 to 15) down for ms [100], or until "up" with ms 0
+ *  up                release every matrix key
+ *  turn n            turn the encoder n detents, negative for down
+ *  button n [ms]     hold button n (0 or 1) down for ms [100]
+ *  drive pin 0|1|z   force a pin low, high or leave it alone
+ *  contact a b 0|1   open or close a switch between two pins
+ *  analog pin value  set an ADC reading
+ *  wait ms           pause
+ *  show              print the pins the firmware drives and its last shiftOut byte
+ *  quit
+ *
+ *  Options (defaults in brackets):
+ *  --name=s          shared-memory object name [/phi_interfaces_pins]
+ *  --period-us=n     scan mode: scanner thread period [1000]
+ *  --seconds=n       scan mode: how long to run [10]
+ *  --keep            panel mode: leave the object in place on exit
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#include <Arduino.h>
+#include <host_shm.h>
+#include <phi_interfaces.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Pin layout shared by both sides.
+static byte matrix_pins[]={2,3,4,5,6,7,8,9}; // Four rows, then four columns.
+#define encoder_a 10
+#define encoder_b 11
+static byte button_pins[]={12,13};
+
+static void sleep_ms(unsigned long ms)
+{
+  struct timespec ts;
+  ts.tv_sec=ms/1000;
+  ts.tv_nsec=(ms%1000)*1000000L;
+  nanosleep(&ts,0);
+}
+
+static void matrix_key(host_shm_pins &pins, int n, bool closed)
+{
+  if ((n<0)||(n>15)) return;
+  pins.set_contact(matrix_pins[n/4],matrix_pins[4+n%4],closed);
+}
+
+static const byte quadrature[4]={3,2,0,1}; // Channel levels AB for one detent up of a normally open encoder.
+
+static void turn(host_shm_pins &pins, int detents)
+{
+  host_shm_images *img=pins.image();
+  int dir=(detents<0)?-1:1;
+  for (int d=0;d!=detents;d+=dir)
+  {
+    for (int i=1;i<=4;i++)
+    {
+      byte s=quadrature[(dir>0)?(i%4):((4-i)%4)];
+      img->drive[encoder_a]=(s>>1)&1;
+      img->drive[encoder_b]=s&1;
+      sleep_ms(2);
+    }
+  }
+}
+
+static int panel(const char *name, bool keep)
+{
+  host_shm_pins pins;
+  if (!pins.create(name))
+  {
+    fprintf(stderr,"Can't create %s\n",name);
+    return 1;
+  }
+  host_shm_images *img=pins.image();
+  img->drive[encoder_a]=HIGH; // Resting in a detent.
+  img->drive[encoder_b]=HIGH;
+  printf("Panel ready on %s\n",name);
+  fflush(stdout);
+  char line[128];
+  while (fgets(line,sizeof(line),stdin))
+  {
+    char cmd[16];
+    int a=0, b=0, c=0;
+    char z[4]="";
+    int n=sscanf(line,"%15s %d %d %d",cmd,&a,&b,&c);
+    if (n<1) continue;
+    if (!strcmp(cmd,"quit")) break;
+    else if (!strcmp(cmd,"key"))
+    {
+      int ms=(n>=3)?b:100;
+      matrix_key(pins,a,true);
+      if (ms)
+      {
+        sleep_ms(ms);
+        matrix_key(pins,a,false);
+      }
+    }
+    else if (!strcmp(cmd,"up")) for (int k=0;k<16;k++) matrix_key(pins,k,false);
+    else if (!strcmp(cmd,"turn")) turn(pins,a);
+    else if (!strcmp(cmd,"button")&&(a>=0)&&(a<2))
+    {
+      img->drive[button_pins[a]]=LOW;
+      sleep_ms((n>=3)?b:100);
+      img->drive[button_pins[a]]=host_shm_float;
+    }
+    else if (!strcmp(cmd,"drive")&&(sscanf(line,"%*s %d %3s",&a,z)==2)&&(a>=0)&&(a<host_pin_count))
+    {
+      img->drive[a]=(z[0]=='z')?host_shm_float:(z[0]=='1'?HIGH:LOW);
+    }
+    else if (!strcmp(cmd,"contact")&&(n>=4)) pins.set_contact(a,b,c!=0);
+    else if (!strcmp(cmd,"analog")&&(n>=3)&&(a>=0)&&(a<host_pin_count)) img->analog[a]=b;
+    else if (!strcmp(cmd,"wait")) sleep_ms(a);
+    else if (!strcmp(cmd,"show"))
+    {
+      for (int p=0;p<host_pin_count;p++) if (img->mode[p]==OUTPUT) printf("pin %d out %d\n",p,img->level[p]);
+      printf("shiftOut %u calls, last 0x%02X\n",(unsigned)img->shift_count,img->shift_value);
+    }
+    else printf("? %s",line);
+    fflush(stdout);
+  }
+  pins.close();
+  if (!keep) host_shm_pins::remove(name);
+  return 0;
+}
+
+static int scan(const char *name, unsigned long period_us, unsigned long seconds)
+{
+  host_shm_pins pins;
+  for (int tries=0;!pins.open(name);tries++)
+  {
+    if (tries==50)
+    {
+      fprintf(stderr,"No panel on %s. Start \"host_shm_rig panel\" first.\n",name);
+      return 1;
+    }
+    sleep_ms(100);
+  }
+  pins.attach();
+
+  static char matrix_names[]="123A456B789C*0#D";
+  static char encoder_names[]="UD";
+  static char button_names[]="LR";
+  static phi_matrix_keypads keypad(matrix_names,matrix_pins,4,4);
+  static phi_rotary_encoders_d encoder(encoder_names,encoder_a,encoder_b,20,EncoderType_NO);
+  static phi_button_groups buttons(button_names,button_pins,2);
+  multiple_button_input *devices[]={&keypad,&encoder,&buttons};
+  const char *device_names[]={"matrix","encoder","buttons"};
+
+  host_scan_threads scanner;
+  scanner.start(devices,3,period_us);
+  printf("Scanning %s every %luus for %lus\n",name,period_us,seconds);
+  fflush(stdout);
+  unsigned long long end=host_time_us()+seconds*1000000ULL;
+  while (host_time_us()<end)
+  {
+    host_key_events ev;
+    while (scanner.pop(ev))
+    {
+      printf("%10.3fms %-8s %c status %d\n",ev.t_us/1000.0,device_names[ev.device],ev.key,ev.status);
+    }
+    fflush(stdout);
+    sleep_ms(20); // The main thread may be slow. Keys wait in the queue meanwhile.
+  }
+  scanner.stop();
+  host_key_events ev;
+  while (scanner.pop(ev)) printf("%10.3fms %-8s %c status %d\n",ev.t_us/1000.0,device_names[ev.device],ev.key,ev.status);
+  printf("%lu scans, %lu late, %lu keys lost\n",scanner.scans(),scanner.overruns(),scanner.lost());
+  pins.close();
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *name="/phi_interfaces_pins";
+  unsigned long period_us=1000, seconds=10;
+  bool keep=false;
+  const char *mode=0;
+  for (int i=1;i<argc;i++)
+  {
+    if (!strncmp(argv[i],"--name=",7)) name=argv[i]+7;
+    else if (!strncmp(argv[i],"--period-us=",12)) period_us=strtoul(argv[i]+12,0,10);
+    else if (!strncmp(argv[i],"--seconds=",10)) seconds=strtoul(argv[i]+10,0,10);
+    else if (!strcmp(argv[i],"--keep")) keep=true;
+    else if (argv[i][0]!='-') mode=argv[i];
+    else
+    {
+      fprintf(stderr,"Unknown option %s\n",argv[i]);
+      return 1;
+    }
+  }
+  if (mode&&!strcmp(mode,"panel")) return panel(name,keep);
+  if (mode&&!strcmp(mode,"scan")) return scan(name,period_us,seconds);
+  fprintf(stderr,"Usage: %s panel|scan [options]. See the top of host_shm_rig.cpp.\n",argv[0]);
+  return 1;
+}
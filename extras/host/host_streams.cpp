@@ -0,0 +1,223 @@
+/** \file
+ *  \brief     Host (PC) Stream classes declared in extras/host/host_streams.h.
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600 // posix_openpt and friends
+#endif
+#include <host_streams.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+/*
+Memory ring
+*/
+host_ring_streams::host_ring_streams(size_t c, unsigned long baud)
+{
+  cap=c?c:1;
+  buf=new uint8_t[cap];
+  ready_us=new unsigned long long[cap];
+  head=tail=count=0;
+  dropped=0;
+  char_us=baud?(10000000UL+baud/2)/baud:0;
+  line_free_us=0;
+}
+
+host_ring_streams::~host_ring_streams()
+{
+  delete[] buf;
+  delete[] ready_us;
+}
+
+size_t host_ring_streams::write(uint8_t c)
+{
+  if (count==cap)
+  {
+    dropped++;
+    return 0;
+  }
+  unsigned long long now=host_time_us();
+  if (line_free_us<now) line_free_us=now; // Line was idle.
+  line_free_us+=char_us;
+  buf[head]=c;
+  ready_us[head]=line_free_us;
+  head=(head+1)%cap;
+  count++;
+  return 1;
+}
+
+int host_ring_streams::available()
+{
+  unsigned long long now=host_time_us();
+  size_t lo=0, hi=count; // Arrival times only go up, so search for the first byte still on the line.
+  while (lo<hi)
+  {
+    size_t mid=(lo+hi)/2;
+    if (ready_us[(tail+mid)%cap]<=now) lo=mid+1;
+    else hi=mid;
+  }
+  return (int)lo;
+}
+
+int host_ring_streams::read()
+{
+  if ((!count)||(ready_us[tail]>host_time_us())) return -1;
+  uint8_t c=buf[tail];
+  tail=(tail+1)%cap;
+  count--;
+  return c;
+}
+
+int host_ring_streams::peek()
+{
+  if ((!count)||(ready_us[tail]>host_time_us())) return -1;
+  return buf[tail];
+}
+
+/*
+File descriptor
+*/
+host_fd_streams::host_fd_streams(int r, int w)
+{
+  rfd=r;
+  wfd=w;
+  look=-1;
+  int fl=fcntl(rfd,F_GETFL);
+  if (fl!=-1) fcntl(rfd,F_SETFL,fl|O_NONBLOCK);
+}
+
+bool host_fd_streams::fill()
+{
+  if (look>=0) return true;
+  uint8_t c;
+  if (::read(rfd,&c,1)!=1) return false;
+  look=c;
+  return true;
+}
+
+size_t host_fd_streams::write(uint8_t c)
+{
+  return write(&c,1);
+}
+
+size_t host_fd_streams::write(const uint8_t *b, size_t n)
+{
+  size_t sent=0;
+  while (sent<n)
+  {
+    ssize_t r=::write(wfd,b+sent,n-sent);
+    if (r<=0) break;
+    sent+=r;
+  }
+  return sent;
+}
+
+int host_fd_streams::available()
+{
+  int n=0;
+  if (ioctl(rfd,FIONREAD,&n)<0) n=0;
+  if (look>=0) n++;
+  else if ((!n)&&fill()) n=1; // FIONREAD is not supported on everything, so try a read.
+  return n;
+}
+
+int host_fd_streams::read()
+{
+  if (!fill()) return -1;
+  int c=look;
+  look=-1;
+  return c;
+}
+
+int host_fd_streams::peek()
+{
+  if (!fill()) return -1;
+  return look;
+}
+
+int host_fd_streams::open_pty(char *name, size_t len)
+{
+  int fd=posix_openpt(O_RDWR|O_NOCTTY);
+  if (fd<0) return -1;
+  if ((grantpt(fd)<0)||(unlockpt(fd)<0))
+  {
+    close(fd);
+    return -1;
+  }
+  struct termios tio;
+  if (tcgetattr(fd,&tio)==0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(fd,TCSANOW,&tio);
+  }
+  const char *slave=ptsname(fd);
+  if (name&&len)
+  {
+    snprintf(name,len,"%s",slave?slave:"");
+  }
+  return fd;
+}
+
+/*
+File replay
+*/
+host_replay_streams::host_replay_streams(unsigned long baud)
+{
+  data=0;
+  len=pos=0;
+  char_us=baud?(10000000UL+baud/2)/baud:0;
+  t_start=0;
+}
+
+host_replay_streams::~host_replay_streams()
+{
+  delete[] data;
+}
+
+bool host_replay_streams::open(const char *path)
+{
+  FILE *f=fopen(path,"rb");
+  if (!f) return false;
+  fseek(f,0,SEEK_END);
+  long n=ftell(f);
+  fseek(f,0,SEEK_SET);
+  if (n<0)
+  {
+    fclose(f);
+    return false;
+  }
+  delete[] data;
+  data=new uint8_t[n?n:1];
+  len=fread(data,1,n,f);
+  fclose(f);
+  pos=0;
+  t_start=host_time_us();
+  return true;
+}
+
+int host_replay_streams::available()
+{
+  size_t arrived=len;
+  if (char_us)
+  {
+    unsigned long long n=(host_time_us()-t_start)/char_us; // Byte i arrives at t_start+(i+1)*char_us.
+    if (n<arrived) arrived=(size_t)n;
+  }
+  return (arrived>pos)?(int)(arrived-pos):0;
+}
+
+int host_replay_streams::read()
+{
+  if (!available()) return -1;
+  return data[pos++];
+}
+
+int host_replay_streams::peek()
+{
+  if (!available()) return -1;
+  return data[pos];
+}
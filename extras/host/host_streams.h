@@ -0,0 +1,75 @@
+/** \file
+ *  \brief     Host (PC) Stream classes to drive phi_serial_keypads without a phi-panel attached.
+ *  \details   Three Streams are provided, all on top of the host Arduino stand-in in Arduino.h:
+ *  host_ring_streams is an in-memory ring. What is written to it can be read back, so one object links a sender and a receiver in the same program. With a baud rate set, each byte only becomes readable one character time after the byte before it, measured on the virtual clock, like a UART.
+ *  host_fd_streams reads and writes a file descriptor without blocking, such as a pipe, a socket or a pseudo-terminal. host_fd_streams::open_pty() makes a pseudo-terminal so a terminal program or a real panel bridged with socat can type into the library.
+ *  host_replay_streams replays a file captured from a serial port, paced at a baud rate on the virtual clock or all at once.
+ *  \author    Dr. John Liu
+ *  \copyright Dr. John Liu. GNU GPL V 3.0.
+*/
+#ifndef host_streams_h
+#define host_streams_h
+
+#include <Arduino.h>
+
+/// In-memory ring Stream, optionally paced at a baud rate on the virtual clock.
+class host_ring_streams: public Stream{
+  public:
+  host_ring_streams(size_t cap, unsigned long baud=0); ///< Makes a ring that holds cap bytes. A baud of 0 makes bytes readable as soon as they are written.
+  ~host_ring_streams();
+  size_t write(uint8_t c);  ///< Adds one byte. Returns 0 if the ring is full.
+  using Print::write;
+  int available();          ///< Returns the number of bytes that have arrived by now on the virtual clock.
+  int read();
+  int peek();
+  size_t size() {return count;} ///< Returns the number of bytes in the ring, arrived or not.
+  unsigned long dropped;    ///< Bytes thrown away because the ring was full.
+
+  private:
+  uint8_t *buf;
+  unsigned long long *ready_us; ///< Virtual time each byte arrives at.
+  size_t cap, head, tail, count;
+  unsigned long char_us;    ///< Virtual time one character takes on the line, 10 bits per character.
+  unsigned long long line_free_us; ///< When the line is done sending the last byte written.
+};
+
+/// Stream on a file descriptor such as a pipe or a pseudo-terminal. Reads never block.
+class host_fd_streams: public Stream{
+  public:
+  host_fd_streams(int rfd, int wfd);   ///< Reads from rfd and writes to wfd. They can be the same descriptor.
+  size_t write(uint8_t c);
+  using Print::write;
+  size_t write(const uint8_t *buf, size_t n);
+  int available();
+  int read();
+  int peek();
+  static int open_pty(char *name, size_t len); ///< Opens a pseudo-terminal in raw mode and returns its master descriptor, or -1. The device to connect to is copied into name.
+
+  private:
+  int rfd, wfd;
+  int look;                 ///< Byte read ahead by available() or peek(), or -1.
+  bool fill();              ///< Reads one byte ahead if there is one.
+};
+
+/// Stream that replays a captured file as if it arrived on a serial line.
+class host_replay_streams: public Stream{
+  public:
+  host_replay_streams(unsigned long baud=0); ///< A baud of 0 makes the whole file readable at once.
+  ~host_replay_streams();
+  bool open(const char *path); ///< Loads a file and starts the replay at the current virtual time. Returns false if it can't be read.
+  size_t write(uint8_t) {return 1;} ///< Anything the library sends back is thrown away.
+  using Print::write;
+  int available();
+  int read();
+  int peek();
+  bool done() {return pos>=len;} ///< Returns true once every byte was read.
+  size_t length() {return len;}  ///< Returns the size of the file.
+
+  private:
+  uint8_t *data;
+  size_t len, pos;
+  unsigned long char_us;
+  unsigned long long t_start;
+};
+
+#endif
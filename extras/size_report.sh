@@ -0,0 +1,93 @@
+#!/bin/sh
+# Flash and RAM report for each device family and keypad feature of
+# phi_interfaces.
+#
+# phi_interfaces.cpp is compiled once with every family turned off, once per
+# family with only that family on, and once with everything on. Flash is text
+# plus data, RAM is data plus bss. Each family's line is what it adds to the
+# bare build. Families built on phi_keypads include its share in their line.
+# phi_device_groups is a template, so it costs nothing until a sketch uses it.
+#
+# Each optional phi_keypads feature is then compiled on and off with the other
+# switches at their defaults. Its line is what it adds to the library, and the
+# keypad column is what it adds to every keypad object, sizeof
+# phi_matrix_keypads, which lives in the sketch's RAM and not in the library's.
+#
+# Run from the library folder. With avr-g++ on the PATH, point ARDUINO_CORE
+# and ARDUINO_VARIANT at the core and variant folders of your Arduino install:
+#
+#   ARDUINO_CORE=~/arduino/hardware/arduino/avr/cores/arduino \
+#   ARDUINO_VARIANT=~/arduino/hardware/arduino/avr/variants/standard \
+#   sh extras/size_report.sh
+#
+# MCU picks the chip [atmega328p]. Without avr-g++, or with CXX=g++, the host
+# stand-in in extras/host is used, which gives sizes for the PC, not the board.
+
+families="rotary_encoders encoder_banks serial_keypads joysticks analog_keypads matrix_keypads button_groups liudr_keypads adc_schedulers device_groups"
+features="chords slicing key_handlers layers calibration integrator background_scan latency_histograms"
+
+if [ -z "$CXX" ] && command -v avr-g++ >/dev/null 2>&1; then
+  CXX=avr-g++
+fi
+CXX=${CXX:-g++}
+case "$CXX" in
+  *avr-*)
+    SIZE=${SIZE:-avr-size}
+    if [ -z "$ARDUINO_CORE" ] || [ -z "$ARDUINO_VARIANT" ]; then
+      echo "Set ARDUINO_CORE and ARDUINO_VARIANT to build with $CXX." >&2
+      exit 1
+    fi
+    FLAGS="-mmcu=${MCU:-atmega328p} -DF_CPU=16000000L -DARDUINO=10605 -I $ARDUINO_CORE -I $ARDUINO_VARIANT"
+    ;;
+  *)
+    SIZE=${SIZE:-size}
+    FLAGS="-DARDUINO=10605 -I extras/host"
+    ;;
+esac
+FLAGS="$FLAGS -std=gnu++11 -Os -ffunction-sections -fdata-sections -I ."
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+# Prints "flash ram" of phi_interfaces.cpp built with the given -D flags.
+measure() {
+  $CXX $FLAGS "$@" -c phi_interfaces.cpp -o "$tmp/phi.o" || exit 1
+  $SIZE "$tmp/phi.o" | awk 'NR==2 {print $1+$2, $2+$3}'
+}
+
+# Prints sizeof(phi_matrix_keypads) built with the given -D flags. It is read
+# from an object file, so it works when cross-compiling too.
+keypad_bytes() {
+  printf '#include <phi_interfaces.h>\nchar phi_keypad_bytes[sizeof(phi_matrix_keypads)];\n' >"$tmp/keypad.cpp"
+  $CXX $FLAGS "$@" -c "$tmp/keypad.cpp" -o "$tmp/keypad.o" || exit 1
+  $SIZE "$tmp/keypad.o" | awk 'NR==2 {print $3}'
+}
+
+# Prints the -D flags that turn every family off except the one named.
+only() {
+  for f in $families; do
+    if [ "$f" = "$1" ]; then echo "-Dphi_enable_$f=1"; else echo "-Dphi_enable_$f=0"; fi
+  done
+}
+
+set -- $(measure $(only none))
+base_flash=$1
+base_ram=$2
+
+echo "Compiler: $CXX"
+printf '%-20s %8s %8s\n' family flash ram
+printf '%-20s %8s %8s\n' "(bare)" "$base_flash" "$base_ram"
+for f in $families; do
+  set -- $(measure $(only $f))
+  printf '%-20s %+8d %+8d\n' "$f" $(($1-base_flash)) $(($2-base_ram))
+done
+set -- $(measure)
+printf '%-20s %8s %8s\n' "(all)" "$1" "$2"
+
+echo
+printf '%-20s %8s %8s %8s\n' feature flash ram keypad
+printf '%-20s %8s %8s %8s\n' "(defaults)" "$1" "$2" "$(keypad_bytes)"
+for f in $features; do
+  set -- $(measure -Dphi_enable_$f=0) $(keypad_bytes -Dphi_enable_$f=0) $(measure -Dphi_enable_$f=1) $(keypad_bytes -Dphi_enable_$f=1)
+  printf '%-20s %+8d %+8d %+8d\n' "$f" $(($4-$1)) $(($5-$2)) $(($6-$3))
+done
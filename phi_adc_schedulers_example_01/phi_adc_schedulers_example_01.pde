@@ -0,0 +1,61 @@
+/** \file
+ *  \brief     This is the first official release of the phi_interfaces library.
+ *  \details   This library unites buttons, rotary encoders and several types of keypads libraries under one library, the phi_interfaces library, for easy of use. This is the first official release. All currently supported input devices are buttons, matrix keypads, rotary encoders, analog buttons, and liudr pads. User is encouraged to obtain compatible hardware from liudr or is solely responsible for converting it to work on other shields or configurations.
+ *  \author    Dr. John Liu
+ *  \version   1.0
+ *  \date      01/24/2012
+ *  \pre       Compatible with Arduino IDE 1.0 and 0022.
+ *  \bug       Not tested on, Arduino IDE 0023 or arduino MEGA hardware!
+ *  \warning   PLEASE DO NOT REMOVE THIS COMMENT WHEN REDISTRIBUTING! No warranty!
+ *  \copyright Dr. John Liu. Free software for educational and personal uses. Commercial use without authorization is prohibited.
+ *  \par Contact
+ * Obtain the documentation or find details of the phi_interfaces, phi_prompt TUI library, Phi-2 shield, and Phi-panel hardware or contact Dr. Liu at:
+ *
+ * <a href="http://liudr.wordpress.com/phi_interfaces/">http://liudr.wordpress.com/phi_interfaces/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-panel/">http://liudr.wordpress.com/phi-panel/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi_prompt/">http://liudr.wordpress.com/phi_prompt/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-2-shield/">http://liudr.wordpress.com/phi-2-shield/</a>
+*/
+
+#if ARDUINO < 100
+#include <WProgram.h>
+#else
+#include <Arduino.h>
+#endif
+
+#include <phi_interfaces.h>
+
+#define EncoderDetent 12
+
+char key_mapping[]={'1','2','3','4','5'}; // This is an analog keypad on A0.
+byte key_pins[]={A0};
+int key_values[]={0, 146, 342, 513, 744}; //These numbers need to increase monotonically.
+phi_analog_keypads panel_keypad(key_mapping, key_pins, key_values, 1, 5);
+
+char dial_mapping[]={'U','D'}; // This is an analog rotary encoder on A1.
+byte analog_vals[]={151,128,0,80};
+phi_rotary_encoders_a my_encoder(dial_mapping, A1, analog_vals, EncoderDetent, EncoderType_NO);
+
+multiple_button_input* inputs[]={&panel_keypad, &my_encoder};
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println("Phi_interfaces library ADC scheduler test code");
+  phi_adc_schedulers::add_pin(A0); // Both devices now read their pins from the scheduler without waiting for conversions.
+  phi_adc_schedulers::add_pin(A1);
+  phi_adc_schedulers::begin(); // Optional, AVR only. The ADC interrupt keeps the samples current from now on.
+}
+
+void loop()
+{
+  phi_adc_schedulers::service(); // Optional without begin(). Calling it from loop keeps the samples fresh even when the devices are not polled. It returns right away after begin().
+  for (byte i=0;i<2;i++)
+  {
+    char temp=inputs[i]->getKey();
+    if (temp!=NO_KEY) Serial.write(temp);
+  }
+}
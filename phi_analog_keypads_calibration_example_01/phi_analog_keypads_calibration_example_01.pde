@@ -0,0 +1,76 @@
+/** \file
+ *  \brief     This is the first official release of the phi_interfaces library.
+ *  \details   This library unites buttons, rotary encoders and several types of keypads libraries under one library, the phi_interfaces library, for easy of use. This is the first official release. All currently supported input devices are buttons, matrix keypads, rotary encoders, analog buttons, and liudr pads. User is encouraged to obtain compatible hardware from liudr or is solely responsible for converting it to work on other shields or configurations.
+ *  \author    Dr. John Liu
+ *  \version   1.0
+ *  \date      01/24/2012
+ *  \pre       Compatible with Arduino IDE 1.0 and 0022.
+ *  \bug       Not tested on, Arduino IDE 0023 or arduino MEGA hardware!
+ *  \warning   PLEASE DO NOT REMOVE THIS COMMENT WHEN REDISTRIBUTING! No warranty!
+ *  \copyright Dr. John Liu. Free software for educational and personal uses. Commercial use without authorization is prohibited.
+ *  \par Contact
+ * Obtain the documentation or find details of the phi_interfaces, phi_prompt TUI library, Phi-2 shield, and Phi-panel hardware or contact Dr. Liu at:
+ *
+ * <a href="http://liudr.wordpress.com/phi_interfaces/">http://liudr.wordpress.com/phi_interfaces/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-panel/">http://liudr.wordpress.com/phi-panel/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi_prompt/">http://liudr.wordpress.com/phi_prompt/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-2-shield/">http://liudr.wordpress.com/phi-2-shield/</a>
+*/
+
+#if ARDUINO < 100
+#include <WProgram.h>
+#else
+#include <Arduino.h>
+#endif
+
+#include <EEPROM.h>
+#include <phi_interfaces.h>
+
+#define buttons_per_column 5 // Each analog pin has five buttons with resistors.
+#define buttons_per_row 1 // There is one analog pin in use.
+#define total_keys (buttons_per_column*buttons_per_row)
+#define cal_address 0 // Where the calibration is saved in EEPROM.
+
+char mapping[]={'1','2','3','4','5'}; // This is an analog keypad.
+byte pins[]={0}; // The pin numbers are analog pin numbers.
+int values[]={0, 146, 342, 513, 744}; //These numbers need to increase monotonically.
+phi_analog_keypads panel_keypad(mapping, pins, values, buttons_per_row, buttons_per_column);
+phi_analog_cal key_cal[total_keys];
+byte blob[total_keys*3+2];
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println("Phi_interfaces library analog keypad calibration test code");
+  panel_keypad.set_calibration(key_cal, total_keys); // Starts from the values above.
+  for (byte i=0;i<sizeof(blob);i++) blob[i]=EEPROM.read(cal_address+i);
+  if (panel_keypad.set_calibration_blob(blob, sizeof(blob))) Serial.println("Loaded calibration from EEPROM");
+  else Serial.println("No calibration saved. Send c to calibrate.");
+}
+
+void calibrate()
+{
+  for (byte k=0;k<total_keys;k++)
+  {
+    Serial.print("Hold key ");
+    Serial.write(mapping[k]);
+    Serial.println(" and send any character");
+    while (!Serial.available());
+    Serial.read();
+    if (panel_keypad.calibrate_key(k, 32)) Serial.println("OK");
+    else Serial.println("Readings unsteady or not this key, kept the old values");
+  }
+  byte n=panel_keypad.get_calibration_blob(blob, sizeof(blob));
+  for (byte i=0;i<n;i++) EEPROM.write(cal_address+i, blob[i]);
+  Serial.println("Saved");
+}
+
+void loop()
+{
+  if (Serial.available()&&(Serial.read()=='c')) calibrate();
+  byte temp=panel_keypad.getKey(); // Every confirmed press also nudges the key's calibration toward its current reading.
+  if (temp!=NO_KEY) Serial.write(temp);
+}
@@ -14,6 +14,178 @@ unsigned int multiple_button_input::buttons_repeat_time=buttons_repeat_time_def;
 unsigned int multiple_button_input::buttons_dash_time=buttons_dash_time_def;
 
 unsigned long multiple_button_input::t_last_action=0;
+unsigned long (*multiple_button_input::clock_fn)()=millis;
+unsigned int multiple_button_input::ticks_per_ms=1;
+unsigned long multiple_button_input::buttons_debounce_ticks=buttons_debounce_time_def;
+unsigned long multiple_button_input::buttons_hold_ticks=buttons_hold_time_def;
+unsigned long multiple_button_input::buttons_repeat_ticks=buttons_repeat_time_def;
+unsigned long multiple_button_input::buttons_dash_ticks=buttons_dash_time_def;
+
+#if phi_enable_adc_schedulers
+byte phi_adc_schedulers::pins[adc_channels_max];
+volatile int phi_adc_schedulers::samples[adc_channels_max];
+int phi_adc_schedulers::last_raw[adc_channels_max];
+byte phi_adc_schedulers::pin_count=0;
+volatile byte phi_adc_schedulers::current=0;
+volatile byte phi_adc_schedulers::discard=0;
+volatile byte phi_adc_schedulers::running=0;
+byte phi_adc_schedulers::background=0;
+byte phi_adc_schedulers::reference=DEFAULT;
+void (*phi_adc_schedulers::callback)(byte pin, int sample)=0;
+#endif
+
+#if phi_keypads_used && phi_enable_background_scan
+phi_keypads * phi_keypads::background_list=0;
+byte phi_keypads::timer_ms=1;
+byte phi_keypads::timer_count=0;
+#endif
+
+//Multiple button input class member functions:
+/**
+ * \details This sets the clock that all debounce, hold, repeat and chord timing runs on. The default is millis. With micros, debounce can be set finer than 1ms with set_debounce_us. Any function that returns a time that only goes up, such as a simulated clock in a test, works too.
+ * The clock is read once per scan and every comparison is a difference of unsigned longs, so it keeps working when the clock wraps around (every 71 minutes with micros). Intervals need to be shorter than the wrap time.
+ * \param clock This is the clock function, such as millis or micros.
+ * \param tpm This is how many ticks of the clock make 1ms, 1 for millis and 1000 for micros.
+
+ * Example:
+
+multiple_button_input::set_clock(micros, 1000);
+multiple_button_input::set_debounce_us(2500); // 2.5ms debounce
+ */
+void multiple_button_input::set_clock(unsigned long (*clock)(), unsigned int tpm)
+{
+  unsigned long debounce_us=buttons_debounce_ticks*1000/ticks_per_ms; // Keep a sub-ms debounce set before the switch.
+  clock_fn=clock;
+  ticks_per_ms=tpm?tpm:1;
+  update_ticks();
+  buttons_debounce_ticks=debounce_us*ticks_per_ms/1000;
+}
+
+/**
+ * \details This sets the debounce time in microseconds, for fast-debounce setups that need less than 1ms or something between whole ms. With the default millis clock it is rounded down to whole ms.
+ * \param us This is the debounce time in microseconds.
+ */
+void multiple_button_input::set_debounce_us(unsigned long us)
+{
+  buttons_debounce_time=us/1000;
+  buttons_debounce_ticks=us*ticks_per_ms/1000;
+}
+
+/**
+ * \details This converts the times in ms into clock ticks. It runs when a time or the clock changes, so scans only compare.
+ */
+void multiple_button_input::update_ticks()
+{
+  buttons_debounce_ticks=(unsigned long)buttons_debounce_time*ticks_per_ms;
+  buttons_hold_ticks=(unsigned long)buttons_hold_time*ticks_per_ms;
+  buttons_repeat_ticks=(unsigned long)buttons_repeat_time*ticks_per_ms;
+  buttons_dash_ticks=(unsigned long)buttons_dash_time*ticks_per_ms;
+}
+
+#if phi_enable_rotary_encoders
+//Encoder position member functions:
+/*
+.______     ______        _______.
+|   _  \   /  __  \      /       |
+|  |_)  | |  |  |  |    |   (----`
+|   ___/  |  |  |  |     \   \    
+|  |      |  `--'  | .----)   |   
+| _|       \______/  |_______/    
+*/
+/**
+ * \details Clears the position and disables the index. The encoder constructors call this.
+ */
+void phi_encoder_positions::init_position()
+{
+  position=0;
+  index_pin=encoder_no_index;
+  index_level=LOW;
+  index_state=0;
+}
+
+/**
+ * \details Returns the multi-turn position. A long takes four loads on AVR so interrupts are held off during the copy, in case getKey is called from an interrupt.
+ * \return It returns the number of detents turned up minus the number turned down since the position was last set or re-homed.
+ */
+long phi_encoder_positions::get_position()
+{
+#if defined(__AVR__)
+  byte sreg=SREG;
+  cli();
+  long pos=position;
+  SREG=sreg;
+  return pos;
+#else
+  return position;
+#endif
+}
+
+/**
+ * \details Sets the multi-turn position, such as zero when the knob is at a known place.
+ * \param pos This is the new position in detents.
+ */
+void phi_encoder_positions::set_position(long pos)
+{
+#if defined(__AVR__)
+  byte sreg=SREG;
+  cli();
+  position=pos;
+  SREG=sreg;
+#else
+  position=pos;
+#endif
+}
+
+/**
+ * \details Sets the index (Z) channel of the encoder. Each time the index turns active, getKey snaps the position to the nearest whole turn.
+ * \param pin This is the arduino pin connected to the index channel, or encoder_no_index to stop using the index.
+ * \param level This is the level the pin reads when the index is active. With the common to GND and pull up enabled, this is LOW.
+ */
+void phi_encoder_positions::set_index(byte pin, byte level)
+{
+  index_pin=pin;
+  index_level=level;
+  if (index_pin==encoder_no_index) return;
+  pinMode(index_pin, INPUT);
+  digitalWrite(index_pin, HIGH);
+  index_state=(digitalRead(index_pin)==index_level); // Don't re-home if the knob already sits on the index.
+}
+
+/**
+ * \details Moves the position by the detents getKey decoded, then checks the index. getKey calls this every time, even when the knob did not move, so a short index pulse between detents is not missed.
+ * \param dir This is 1 for a detent up, -1 for a detent down or 0 for no detent.
+ * \param det This is the number of detents per rotation.
+ */
+void phi_encoder_positions::update_position(signed char dir, byte det)
+{
+  long pos=position;
+  pos+=dir;
+  if (index_pin!=encoder_no_index)
+  {
+    byte active=(digitalRead(index_pin)==index_level);
+    if (active&&(!index_state)&&det)
+    {
+      long rem=pos%det;
+      if (rem<0) rem+=det;
+      if (rem*2>=det) pos+=det-rem; // Round half a turn or more up to the next turn.
+      else pos-=rem;
+    }
+    index_state=active;
+  }
+  position=pos;
+}
+
+/**
+ * \details Reduces the position to an orientation of the dial.
+ * \param det This is the number of detents per rotation.
+ * \return It returns a value between 0 and det-1.
+ */
+byte phi_encoder_positions::position_angle(byte det)
+{
+  long rem=get_position()%det;
+  if (rem<0) rem+=det;
+  return rem;
+}
 
 //Rotary encoder class member functions:
 /*
@@ -51,7 +223,7 @@ phi_rotary_encoders::phi_rotary_encoders(char *na, byte ChnA, byte ChnB, byte de
 
   detent=det;
   stat_seq_ptr=4; // Center the status of the encoder
-  counter=0;
+  init_position();
 }
 
 /**
@@ -65,14 +237,14 @@ byte phi_rotary_encoders::getKey()
 {
   static const byte stat_seq[]={3,2,0,1,3,2,0,1,3}; // For always on switches use {0,1,3,2,0,1,3,2,0}; For the sake of simple coding, please don't mix always-on encoders with always-off encoders.
   byte stat_int=(digitalRead(EncoderChnB)<<1) | digitalRead(EncoderChnA);
+  signed char dir=0;
   if (stat_int==stat_seq[stat_seq_ptr+1])
   {
     stat_seq_ptr++;
     if (stat_seq_ptr==8)
     {
       stat_seq_ptr=4;
-      counter++;
-      return key_names[0];
+      dir=1;
     }
   }
   else if (stat_int==stat_seq[stat_seq_ptr-1])
@@ -81,10 +253,12 @@ byte phi_rotary_encoders::getKey()
     if (stat_seq_ptr==0)
     {
       stat_seq_ptr=4;
-      counter--;
-      return key_names[1];
+      dir=-1;
     }
   }
+  update_position(dir, detent);
+  if (dir>0) return key_names[0];
+  if (dir<0) return key_names[1];
   return NO_KEY;
 }
 
@@ -116,7 +290,7 @@ byte phi_rotary_encoders::get_sensed()
 byte phi_rotary_encoders::get_angle()
 {
   getKey();
-  return (((int)counter)%detent+detent)%detent;
+  return position_angle(detent);
 }
 
 /*
@@ -133,7 +307,7 @@ ______ _____ _____ ___  ________   __    ______
  * \param ChnA This is the arduino pin connected to the encoder channel A.
  * \param ChnB This is the arduino pin connected to the encoder channel B.
  * \param det This is the number of detent per rotation.
- * \param en_type This is the type of rotary encoder, EncoderType_NO, EncoderType_NC. EncoderType_OC is not yet supported. See #defines in the header file.
+ * \param en_type This is the type of rotary encoder, EncoderType_NO, EncoderType_NC or EncoderType_OC. See #defines in the header file.
 
  * Example:
  
@@ -155,8 +329,9 @@ phi_rotary_encoders_d::phi_rotary_encoders_d(char *na, byte ChnA, byte ChnB, byt
 	digitalWrite(EncoderChnB, HIGH);
 
 	detent=det;
-	counter=0;
+	init_position();
 	stat_seq_ptr=4; // Center the status of the encoder
+	rest_state=B11;
 }
 
 /**
@@ -173,34 +348,40 @@ byte phi_rotary_encoders_d::get_encoder_state()
 /**
  * \details This actually performs the encoder read and returns up or down dials with the translation done by key_names.
  * If you are not very interested in the inner working of this library, this is the only function you need to call to get a response on the rotary encoder.
- * It assumes the channels are off when the knob is in a groove. To assume the channels are on when the knob is in a groove, read the code on stat_deq.
+ * The grooves the knob rests in depend on EncoderType. NO and NC encoders rest in one state and report a detent after a full cycle of four states. OC encoders rest in both 11B and 00B and report a detent every half cycle, so none of their detents are lost.
  * To properly sense the encoder, call this function inside of a loop.
  * \return It returns the named keys defined by the constructor such as 'U' and 'D' for up and down dial rotations.
  */
 byte phi_rotary_encoders_d::getKey()
 {
-	static const byte stat_seq[]={3,2,0,1,3,2,0,1,3}; // For always on switches use {0,1,3,2,0,1,3,2,0}; For the sake of simple coding, please don't mix always-on encoders with always-off encoders.
+	static const byte stat_seqs[2][9]={{3,2,0,1,3,2,0,1,3},{0,1,3,2,0,1,3,2,0}}; // Walks centered on resting state 11B and 00B. NC encoders are inverted to rest in 11B by get_encoder_state. OC encoders rest in either.
+	const byte *stat_seq=stat_seqs[rest_state==0];
+	byte half=(EncoderType==EncoderType_OC)?2:4; // An OC encoder reaches its next detent halfway through the sequence.
 	byte stat_int=get_encoder_state();// This layer separates the actual sensing of either analog or digital signal from the logic layer.
+	signed char dir=0;
 	if (stat_int==stat_seq[stat_seq_ptr+1])
 	{
 		stat_seq_ptr++;
-		if (stat_seq_ptr==8)
+		if (stat_seq_ptr==4+half)
 		{
 			stat_seq_ptr=4;
-			counter++;
-			return key_names[0];
+			dir=1;
 		}
 	}
 	else if (stat_int==stat_seq[stat_seq_ptr-1])
 	{
 		stat_seq_ptr--;
-		if (stat_seq_ptr==0)
+		if (stat_seq_ptr==4-half)
 		{
 			stat_seq_ptr=4;
-			counter--;
-			return key_names[1];
+			dir=-1;
 		}
 	}
+	else if ((EncoderType==EncoderType_OC)&&(stat_seq_ptr==4)&&(stat_int==(rest_state^B11))) rest_state=stat_int; // Found resting in the other detent state, such as at power up or after a missed poll. Direction is unknown so just follow it.
+	if (dir&&(EncoderType==EncoderType_OC)) rest_state=stat_int; // The walk continues from the detent just reached.
+	update_position(dir, detent);
+	if (dir>0) return key_names[0];
+	if (dir<0) return key_names[1];
 	return NO_KEY;
 }
 
@@ -232,7 +413,7 @@ byte phi_rotary_encoders_d::get_sensed()
 byte phi_rotary_encoders_d::get_angle()
 {
   getKey();
-  return (((int)counter)%detent+detent)%detent;
+  return position_angle(detent);
 }
 
 
@@ -269,8 +450,9 @@ phi_rotary_encoders_a::phi_rotary_encoders_a(char *na, byte ChnA, byte *vals, by
 	EncoderType=en_type;
 	detent=det;
 	analog_values=vals;
-	counter=0;
+	init_position();
 	stat_seq_ptr=4; // Center the status of the encoder
+	rest_state=B11;
 }
 
 /**
@@ -284,7 +466,7 @@ byte phi_rotary_encoders_a::get_encoder_state(byte prev_state)
 	byte ret_val=B11;
 	byte found_val=0; // Sometimes analog value strays away from the expected values and we may find no value.
 	//analogRead(ChnAnalog); // Read and discard.
-	analog_in=analogRead(ChnAnalog)/4; // Read once and discard.
+	analog_in=phi_analog_read(ChnAnalog)/4; // Read once and discard. Latest sample without waiting if the pin is scheduled with phi_adc_schedulers.
 	
 	/*for (byte i=0;i<4;i++)
 	{
@@ -306,34 +488,40 @@ byte phi_rotary_encoders_a::get_encoder_state(byte prev_state)
 /**
  * \details This actually performs the encoder read and returns up or down dials with the translation done by key_names.
  * If you are not very interested in the inner working of this library, this is the only function you need to call to get a response on the rotary encoder.
- * It assumes the channels are off when the knob is in a groove. To assume the channels are on when the knob is in a groove, read the code on stat_deq.
+ * The grooves the knob rests in depend on EncoderType. NO and NC encoders rest in one state and report a detent after a full cycle of four states. OC encoders rest in both 11B and 00B and report a detent every half cycle, so none of their detents are lost.
  * To properly sense the encoder, call this function inside of a loop.
  * \return It returns the named keys defined by the constructor such as 'U' and 'D' for up and down dial rotations.
  */
 byte phi_rotary_encoders_a::getKey()
 {
-  static const byte stat_seq[]={3,2,0,1,3,2,0,1,3}; // For always on switches use {0,1,3,2,0,1,3,2,0}; For the sake of simple coding, please don't mix always-on encoders with always-off encoders.
+  static const byte stat_seqs[2][9]={{3,2,0,1,3,2,0,1,3},{0,1,3,2,0,1,3,2,0}}; // Walks centered on resting state 11B and 00B. NC encoders are inverted to rest in 11B by get_encoder_state. OC encoders rest in either.
+  const byte *stat_seq=stat_seqs[rest_state==0];
+  byte half=(EncoderType==EncoderType_OC)?2:4; // An OC encoder reaches its next detent halfway through the sequence.
   byte stat_int=get_encoder_state(stat_seq[stat_seq_ptr]);// This layer separates the actual sensing of either analog or digital signal from the logic layer. Due to analog nature sometimes stray value is read so previous state is supplied.
+  signed char dir=0;
   if (stat_int==stat_seq[stat_seq_ptr+1])
   {
     stat_seq_ptr++;
-    if (stat_seq_ptr==8)
+    if (stat_seq_ptr==4+half)
     {
       stat_seq_ptr=4;
-      counter++;
-      return key_names[0];
+      dir=1;
     }
   }
   else if (stat_int==stat_seq[stat_seq_ptr-1])
   {
     stat_seq_ptr--;
-    if (stat_seq_ptr==0)
+    if (stat_seq_ptr==4-half)
     {
       stat_seq_ptr=4;
-      counter--;
-      return key_names[1];
+      dir=-1;
     }
   }
+  else if ((EncoderType==EncoderType_OC)&&(stat_seq_ptr==4)&&(stat_int==(rest_state^B11))) rest_state=stat_int; // Found resting in the other detent state, such as at power up or after a missed poll. Direction is unknown so just follow it.
+  if (dir&&(EncoderType==EncoderType_OC)) rest_state=stat_int; // The walk continues from the detent just reached.
+  update_position(dir, detent);
+  if (dir>0) return key_names[0];
+  if (dir<0) return key_names[1];
   return NO_KEY;
 }
 
@@ -365,9 +553,207 @@ byte phi_rotary_encoders_a::get_sensed()
 byte phi_rotary_encoders_a::get_angle()
 {
   getKey();
-  return (((int)counter)%detent+detent)%detent;
+  return position_angle(detent);
+}
+
+#endif
+
+#if phi_enable_encoder_banks
+/*
+______  ___   _   _  _   __
+| ___ \/ _ \ | \ | || | / /
+| |_/ / /_\ \|  \| || |/ / 
+| ___ \  _  || . ` ||    \ 
+| |_/ / | | || |\  || |\  \
+\____/\_| |_/\_| \_/\_| \_/
+*/
+/**
+ * \details Quadrature decoding table shared by all encoder banks. It is indexed by previous state times 4 plus current state, each state with channel A at 1th bit and channel B at 0th bit.
+ * A move along 3,2,0,1,3 is +1 (up), the reverse is -1 (down). No change and impossible double changes (bounce or a missed poll) are 0.
+ */
+static const signed char encoder_bank_table[16] PROGMEM={0,1,-1,0, -1,0,0,1, 1,0,0,-1, 0,-1,1,0};
+
+/**
+ * \details Constructor for a bank of rotary encoders. Provide the names of up and down actions of every encoder, the arduino pins of every encoder, and number of detent per rotation. All encoders in a bank need to be the same type and detent. Please define the shaft clicks as a regular phi_button_groups object.
+ * \param na This is the name of (or pointer to) a char array that stores the names of dial up then dial down for each encoder, two elements per encoder.
+ * \param pins This is the name of (or pointer to) a byte array that stores channel A then channel B of each encoder, two elements per encoder.
+ * \param n This is the number of encoders, up to encoder_bank_max.
+ * \param det This is the number of detent per rotation.
+ * \param en_type This is the type of rotary encoder, EncoderType_NO or EncoderType_NC. See #defines in the header file.
+
+ * Example:
+
+char mapping[]={'U','D','L','R','A','B'}; // Encoder 1 returns U and D, encoder 2 returns L and R, encoder 3 returns A and B.
+byte pins[]={2,3,4,5,6,7}; // Channels A and B of encoder 1, then encoder 2, then encoder 3.
+
+phi_rotary_encoder_banks my_encoders(mapping, pins, 3, EncoderDetent, EncoderType_NO); // Replace EncoderDetent with actual number.
+ */
+phi_rotary_encoder_banks::phi_rotary_encoder_banks(char *na, byte *pins, byte n, byte det, byte en_type)
+{
+	device_type=Rotary_encoder;
+	key_names=na; // Translated names of the keys, such as '0'.
+	EncoderPins=pins;
+	encoders=(n>encoder_bank_max)?encoder_bank_max:n;
+	EncoderType=en_type;
+	detent=det;
+#ifdef __AVR__
+	port_count=0;
+#endif
+
+	for (byte i=0;i<encoders*2;i++)
+	{
+		pinMode(EncoderPins[i], INPUT);
+		digitalWrite(EncoderPins[i], HIGH);
+#ifdef __AVR__
+		volatile uint8_t *reg=portInputRegister(digitalPinToPort(EncoderPins[i]));
+		byte p=0;
+		while ((p<port_count)&&(port_regs[p]!=reg)) p++; // Channels on the same port share one register read.
+		if ((p==port_count)&&(port_count<encoder_bank_ports)) port_regs[port_count++]=reg;
+		chn_port[i]=(p<port_count)?p:255;
+		chn_mask[i]=digitalPinToBitMask(EncoderPins[i]);
+#endif
+	}
+	for (byte e=0;e<encoders;e++)
+	{
+		states[e]=B11;
+		steps[e]=0;
+		pending[e]=0;
+		counters[e]=0;
+	}
+}
+
+/**
+ * \details This reads all channels once and decodes every encoder. On AVR, each port that has channels on it is read once into a snapshot and channels are picked out with bit masks.
+ * Each encoder's move is looked up in the shared table and added to its quarter steps. When the encoder is back in its detent, two or more quarter steps either way count as one detent, which rides over bounce on a single channel.
+ */
+void phi_rotary_encoder_banks::update()
+{
+#ifdef __AVR__
+	byte snapshot[encoder_bank_ports];
+	for (byte p=0;p<port_count;p++) snapshot[p]=*port_regs[p];
+#endif
+	for (byte e=0;e<encoders;e++)
+	{
+		byte a, b;
+#ifdef __AVR__
+		if (chn_port[2*e]!=255) a=(snapshot[chn_port[2*e]]&chn_mask[2*e])?1:0;
+		else a=digitalRead(EncoderPins[2*e]);
+		if (chn_port[2*e+1]!=255) b=(snapshot[chn_port[2*e+1]]&chn_mask[2*e+1])?1:0;
+		else b=digitalRead(EncoderPins[2*e+1]);
+#else
+		a=digitalRead(EncoderPins[2*e]);
+		b=digitalRead(EncoderPins[2*e+1]);
+#endif
+		byte st=(a<<1)|b;
+		if (EncoderType==EncoderType_NC) st=(~st)&B11;
+		if (st==states[e]) continue;
+		steps[e]+=(signed char)pgm_read_byte(&encoder_bank_table[(states[e]<<2)|st]);
+		states[e]=st;
+		if (st==B11) // Back in the detent
+		{
+			if ((steps[e]>=2)&&(pending[e]<127))
+			{
+				pending[e]++;
+				if (++counters[e]>=detent) counters[e]=0; // Kept between 0 and detent-1 so turning back past 0 doesn't wrap the byte.
+			}
+			else if ((steps[e]<=-2)&&(pending[e]>-127))
+			{
+				pending[e]--;
+				counters[e]=(counters[e]?counters[e]:detent)-1;
+			}
+			steps[e]=0;
+		}
+	}
+}
+
+/**
+ * \details This reads all encoders once and reports how many detents each one turned since the last call. Use this to update many dials in one call.
+ * To properly sense the encoders, call this function inside of a loop.
+ * \param deltas This is the name of (or pointer to) a signed char array with one element per encoder. Each element gets the detents turned, positive for up and negative for down.
+ * \return It returns the number of encoders that turned.
+ */
+byte phi_rotary_encoder_banks::poll(signed char *deltas)
+{
+	byte moved=0;
+	update();
+	for (byte e=0;e<encoders;e++)
+	{
+		deltas[e]=pending[e];
+		if (pending[e]) moved++;
+		pending[e]=0;
+	}
+	return moved;
+}
+
+/**
+ * \details This reads all encoders once and returns one dial up or down with the translation done by key_names. If several encoders turned, the rest are returned by the next calls.
+ * To properly sense the encoders, call this function inside of a loop.
+ * \return It returns the named keys defined by the constructor such as 'U' and 'D' for up and down dial rotations.
+ */
+byte phi_rotary_encoder_banks::getKey()
+{
+	update();
+	for (byte e=0;e<encoders;e++)
+	{
+		if (pending[e]>0)
+		{
+			pending[e]--;
+			return key_names[2*e];
+		}
+		if (pending[e]<0)
+		{
+			pending[e]++;
+			return key_names[2*e+1];
+		}
+	}
+	return NO_KEY;
+}
+
+/**
+ * \details This always returns buttons_up due to the fact that rotary encoders can't assume other status.
+ * \return This function is defined only to be compatible with the parent class and always returns buttons_up. 
+ */
+byte phi_rotary_encoder_banks::get_status()
+{
+  return buttons_up;
+}
+
+/**
+ * \details This always returns NO_KEY due to the nature of rotary encoders.
+ * \return This function is defined only to be compatible with the parent class and always returns NO_KEY. 
+ */
+byte phi_rotary_encoder_banks::get_sensed()
+{
+  return NO_KEY;
+}
+
+/**
+ * \details Get the angle or orientation of one encoder between 0 and detent-1. Unlike the single encoder classes, this doesn't poll the encoders, so call poll or getKey in your loop.
+ * \param enc This is the encoder number, 0 to n-1.
+ * \return It returns a value between 0 and detent-1. You can calculate angle with it return.
+ */
+byte phi_rotary_encoder_banks::get_angle(byte enc)
+{
+  if (enc>=encoders) return 0;
+  return counters[enc];
 }
 
+#endif
+
+#if phi_enable_serial_keypads || (phi_keypads_used && phi_enable_calibration)
+/**
+ * \details CRC-8 with polynomial 0x07, used to check data saved or sent by the library.
+ */
+static byte crc8_update(byte crc, byte data)
+{
+  crc^=data;
+  for (byte b=0;b<8;b++) crc=(crc&0x80)?(crc<<1)^0x07:(crc<<1);
+  return crc;
+}
+
+#endif
+
+#if phi_enable_serial_keypads
 //Serials class member functions:
 /*
      _______. _______ .______       __       ___       __
@@ -388,166 +774,1312 @@ phi_serial_keypads::phi_serial_keypads(Stream *ser, unsigned long bau)
   device_type=Serial_keypad;
   ser_baud=bau;
   ser_port=ser;
+  set_frame_buffers(0,0,0,0);
 }
 
 /**
  * \details This acquires one character from a serial port as a key press. If the port is empty then it returns NO_KEY.
  * If you are not very interested in the inner working of this library, this is the only function you need to call to get a response on the rotary encoder.
+ * With a receive ring set by set_frame_buffers, it reads framed events instead and returns the key of the next press or repeat. Hold and release events are passed over but still show up in get_status.
  * \return It returns the serial port content in byte data type or NO_KEY.
  */
 byte phi_serial_keypads::getKey()
 {
+  if (rx_ring)
+  {
+    phi_key_events ev;
+    while (read_event(&ev))
+    {
+      if ((ev.event==buttons_pressed)||(ev.event==buttons_repeated)) return ev.key;
+    }
+    return NO_KEY;
+  }
   if (ser_port->available()) return ser_port->read();
   else return NO_KEY;
 }  
 
-//Keypad class member functions:
-/*
- __  ___  ___________    ____ .______      ___       _______  
-|  |/  / |   ____\   \  /   / |   _  \    /   \     |       \ 
-|  '  /  |  |__   \   \/   /  |  |_)  |  /  ^  \    |  .--.  |
-|    <   |   __|   \_    _/   |   ___/  /  /_\  \   |  |  |  |
-|  .  \  |  |____    |  |     |  |     /  _____  \  |  '--'  |
-|__|\__\ |_______|   |__|     | _|    /__/     \__\ |_______/ 
-*/
 /**
- * \details Outputs the name of the last sensed key or NO_KEY. If all you want is to  sense a key press, use getKey instead. You can use this in conjunction with get_status to sense if a key is held.
- * \return it returns the name of the last sensed key or NO_KEY. This key may not be currently pressed.
- */ 
-byte phi_keypads::get_sensed()
+ * \details Switches the object to framed events. The receive ring holds bytes from the port until a whole frame is there and checked. Events are then read from where they sit, so nothing is copied besides the event you ask for.
+ * The transmit buffer holds the frame queue_event builds. Pass 0 for a buffer this object doesn't need, such as tx on a host that only listens. Pass 0 for both to go back to one key per byte.
+ * \param rx This is the receive ring. Use at least serial_frame_bytes(serial_frame_events_max)+1 bytes so the largest frame fits, and more if getKey is not called often.
+ * \param rx_len This is the size of rx, up to 255.
+ * \param tx This is the transmit frame buffer. serial_frame_bytes(n) bytes hold n events per frame.
+ * \param tx_len This is the size of tx.
+ */
+void phi_serial_keypads::set_frame_buffers(byte *rx, byte rx_len, byte *tx, byte tx_len)
 {
-  if (button_sensed==NO_KEYs) return NO_KEY;
-  else return key_names[button_sensed];
+  rx_ring=rx;
+  rx_size=rx_len;
+  rx_head=0;
+  rx_tail=0;
+  rx_next=0;
+  rx_left=0;
+  tx_frame=tx;
+  tx_max=0;
+  if (tx_len>=serial_frame_bytes(1)) tx_max=(tx_len-serial_frame_bytes(0))/serial_event_bytes;
+  if (tx_max>serial_frame_events_max) tx_max=serial_frame_events_max;
+  if (!tx_max) tx_frame=0;
+  tx_count=0;
+  tx_last=clock_now();
+  frame_key=NO_KEY;
+  frame_status=buttons_up;
 }
 
 /**
- * \details Return status of the sensed key. If there is no sensed key, this return should not be used.
- * \return It returns status of the sensed key.
+ * \details Moves whatever the port has into the receive ring, as long as there is room. Bytes of a frame being read are never overwritten.
  */
-byte phi_keypads::get_status()
+void phi_serial_keypads::receive()
 {
-  return button_status;
+  byte next=rx_head+1;
+  if (next==rx_size) next=0;
+  while ((next!=rx_tail)&&ser_port->available())
+  {
+    rx_ring[rx_head]=ser_port->read();
+    rx_head=next;
+    next=rx_head+1;
+    if (next==rx_size) next=0;
+  }
 }
 
 /**
- * \details This is the public method to get a key press from the keypad. The key press is translated into key_names or NO_KEY.
- * This function is inherited from multiple_button_inputs. All Keypad subclasses such as phi_matrix_keypads and phi_analog_keypads share this code.
- * Since all multiple_button_inputs devices have this method, you can treat all of them as multiple_button_inputs and call this method to get a key press.
- * This is the function you should call to sense key presses. 
- * It is only few lines of code and is generic enough for all phi_keypads.
- * \return It returns the name of the key that is pressed down.
+ * \details Returns a byte of the receive ring counting from rx_tail, wrapping around the end of the ring.
+ * \param i This is how many bytes after rx_tail.
+ * \return It returns the byte.
  */
-byte phi_keypads::getKey()
+byte phi_serial_keypads::rx_at(byte i)
 {
-  byte key=scanKeypad();
-  if (key==NO_KEYs) key=NO_KEY;
-  else key=key_names[key];
-  return key;
+  unsigned int at=rx_tail+i;
+  if (at>=rx_size) at-=rx_size;
+  return rx_ring[at];
 }
 
 /**
- * \details This routine uses senseAll to scan the keypad, use debouncing to update button_sensed and button_status.
- * This function is not intended to be call by arduino code but called within the library instead.
- * If all you want is a key press, call getKey.
- * The getKey calls this function and translates keypress from scan code (0 to max_key-1) into characters or key names.
- * \return This function only returns scan code (0 to max_key-1).
+ * \details Looks for a good frame at the start of the receive ring. Anything that is not a sync byte, a frame with an impossible count or a failed CRC is dropped one byte at a time, so the decoder finds the next frame after noise or a lost byte.
+ * \return It returns 1 if a checked frame's events are ready at rx_tail, 0 if more bytes are needed.
  */
-byte phi_keypads::scanKeypad()
+byte phi_serial_keypads::check_frame()
 {
-  byte button_pressed=sense_all();
-  
-  switch (button_status)
+  while (1)
   {
-    case buttons_up:
-    if (button_pressed!=NO_KEYs)
-    {
-      button_sensed==button_pressed;
-      button_status_t=millis();
-      button_status=buttons_debounce;
-    }
-    else button_sensed=NO_KEYs;
-    break;
-    
-    case buttons_debounce:
-    if (button_pressed!=NO_KEYs)
+    byte avail=(rx_head>=rx_tail)?(rx_head-rx_tail):(rx_size-rx_tail+rx_head);
+    if (!avail) return 0;
+    byte drop=0;
+    if (rx_at(0)!=serial_frame_sync) drop=1;
+    else
     {
-      if (button_sensed==button_pressed)
+      if (avail<2) return 0;
+      byte n=rx_at(1);
+      if ((!n)||(n>serial_frame_events_max)||(serial_frame_bytes(n)>=rx_size)) drop=1; // A frame that can't fit the ring would never complete.
+      else
       {
-        if (millis()-button_status_t>buttons_debounce_time)
+        if (avail<serial_frame_bytes(n)) return 0;
+        byte crc=0;
+        for (byte i=1;i<serial_frame_bytes(n)-1;i++) crc=crc8_update(crc,rx_at(i));
+        if (crc!=rx_at(serial_frame_bytes(n)-1)) drop=1;
+        else
         {
-          button_status=buttons_pressed;
-          button_status_t=millis();
-          t_last_action=button_status_t;
-          return button_sensed;
+          rx_next=2;
+          rx_left=n;
+          return 1;
         }
       }
-      else
-      {
-        button_status_t=millis();
-        button_sensed=button_pressed;
-      }
     }
-    else
-    {
-      button_status=buttons_up;
-      button_sensed=NO_KEYs;
-    }
-    break;
-    
-    case buttons_pressed:
-    if (button_pressed!=NO_KEYs)
-    {
-      if (button_sensed==button_pressed) button_status=buttons_down;
-      else button_status=buttons_debounce;
-      button_status=buttons_down;
-    }
-    else button_status=buttons_released;
-    button_status_t=millis();
-    break;
-    
-    case buttons_down:
-    if (button_sensed==button_pressed)
-    {
-      if (millis()-button_status_t>buttons_hold_time)
-      {
-        button_status=buttons_held;
-        button_status_t=millis();
-      }
-    }
-    else
+    if (drop)
     {
-      button_status=buttons_released;
-      button_status_t=millis();
+      rx_tail++;
+      if (rx_tail==rx_size) rx_tail=0;
     }
-    break;
-    
-    case buttons_released:
-    if (button_pressed==NO_KEYs) button_status=buttons_up;
-    else
-    {
-      button_status=buttons_debounce;
+  }
+}
+
+/**
+ * \details Gets the next framed event received. Call this in your loop instead of getKey if you need hold and release events or their timing. Don't mix the two on one object since both consume events.
+ * \param ev This is where the event is copied to.
+ * \return It returns 1 if an event was copied, or 0 if there was none or no receive ring is set.
+ */
+byte phi_serial_keypads::read_event(phi_key_events *ev)
+{
+  if (!rx_ring) return 0;
+  receive();
+  if ((!rx_left)&&(!check_frame())) return 0;
+  ev->key=rx_at(rx_next);
+  ev->event=rx_at(rx_next+1);
+  ev->dt=rx_at(rx_next+2)|(((unsigned int)rx_at(rx_next+3))<<8);
+  rx_next+=serial_event_bytes;
+  rx_left--;
+  if (!rx_left) // Whole frame read, free its bytes.
+  {
+    unsigned int at=rx_tail+rx_next+1;
+    if (at>=rx_size) at-=rx_size;
+    rx_tail=at;
+  }
+  frame_key=ev->key;
+  frame_status=ev->event;
+  return 1;
+}
+
+/**
+ * \details Adds one event to the frame being built, stamped with the time since the event queued before it. If the frame is already full it is sent first, so events are never lost, but call flush_events in your loop so events don't wait for a full frame.
+ * The arguments match a key handler so you can forward a keypad's events with a one line handler:
+
+void forward(byte key, byte event) {panel_link.queue_event(key,event);}
+
+ * \param key This is the key name.
+ * \param event This is the event, such as buttons_pressed.
+ * \return It returns 1 if the event was queued or 0 without a transmit buffer.
+ */
+byte phi_serial_keypads::queue_event(byte key, byte event)
+{
+  if (!tx_frame) return 0;
+  if (tx_count==tx_max) flush_events();
+  unsigned long t_now=clock_now();
+  unsigned long dt=(t_now-tx_last)/get_ticks_per_ms();
+  tx_last=t_now;
+  if (dt>0xFFFF) dt=0xFFFF;
+  byte *e=tx_frame+2+tx_count*serial_event_bytes;
+  e[0]=key;
+  e[1]=event;
+  e[2]=dt&0xFF;
+  e[3]=dt>>8;
+  tx_count++;
+  return 1;
+}
+
+/**
+ * \details Sends the events queued so far as one frame, with one write to the port. Nothing is sent if no event is queued.
+ * \return It returns the number of events sent.
+ */
+byte phi_serial_keypads::flush_events()
+{
+  if ((!tx_frame)||(!tx_count)) return 0;
+  byte len=serial_frame_bytes(tx_count);
+  tx_frame[0]=serial_frame_sync;
+  tx_frame[1]=tx_count;
+  byte crc=0;
+  for (byte i=1;i<len-1;i++) crc=crc8_update(crc,tx_frame[i]);
+  tx_frame[len-1]=crc;
+  ser_port->write(tx_frame,len);
+  byte sent=tx_count;
+  tx_count=0;
+  return sent;
+}
+
+#endif
+
+#if phi_keypads_used
+#if phi_enable_latency_histograms
+//Latency histogram member functions:
+/**
+ * \details Clears the histogram and stops timing. The keypad constructor calls this.
+ */
+void phi_latency_histograms::init_latency()
+{
+  clear_latency();
+  latency_armed=0;
+  latency_raw=0;
+  latency_t0=0;
+  latency_t_raw=0;
+}
+
+/**
+ * \details Clears every bucket and the longest latency, such as after dumping them.
+ */
+void phi_latency_histograms::clear_latency()
+{
+  for (byte i=0;i<latency_buckets;i++) latency_counts[i]=0;
+  latency_max=0;
+}
+
+/**
+ * \details Returns how many keys had a latency in one bucket. Bucket b holds latencies of 2^(b-1) to 2^b-1 clock ticks, so on millis bucket 5 is 16 to 31ms.
+ * \param bucket This is the bucket, 0 to latency_buckets-1.
+ * \return It returns the count, which stops at 65535.
+ */
+unsigned int phi_latency_histograms::get_latency_count(byte bucket)
+{
+  if (bucket>=latency_buckets) return 0;
+  return latency_counts[bucket];
+}
+
+/**
+ * \details Prints the histogram in one line so it can be collected over a serial port and compared across panels:
+
+lat,<ticks per ms>,<keys>,<longest>,<bucket 0>,<bucket 1>,...
+
+ * Buckets after the last one that counted anything are left out. All times are in clock ticks.
+ * \param out This is where to print, such as &Serial.
+ */
+void phi_latency_histograms::dump_latency(Print *out)
+{
+  unsigned long keys=0;
+  byte last=0;
+  for (byte i=0;i<latency_buckets;i++)
+  {
+    keys+=latency_counts[i];
+    if (latency_counts[i]) last=i+1;
+  }
+  out->print("lat,");
+  out->print(multiple_button_input::get_ticks_per_ms());
+  out->print(',');
+  out->print(keys);
+  out->print(',');
+  out->print(latency_max);
+  for (byte i=0;i<last;i++)
+  {
+    out->print(',');
+    out->print(latency_counts[i]);
+  }
+  out->println();
+}
+
+/**
+ * \details Starts timing when a scan finds a contact after a scan that found none, unless a contact is already being timed. Later bounces of the same press don't restart it.
+ * \param down This is 1 if the scan found any key down before debouncing.
+ * \param t This is the time of the scan.
+ */
+void phi_latency_histograms::latency_sample(byte down, unsigned long t)
+{
+  if (down)
+  {
+    if ((!latency_raw)&&(!latency_armed))
+    {
+      latency_armed=1;
+      latency_t0=t;
+    }
+    latency_t_raw=t;
+  }
+  latency_raw=down;
+}
+
+/**
+ * \details Stops timing if no contact has been sensed for settle ticks, so a glitch isn't counted against the next real press.
+ */
+void phi_latency_histograms::latency_drop(unsigned long t, unsigned long settle)
+{
+  if (latency_armed&&(!latency_raw)&&(t-latency_t_raw>settle)) latency_armed=0;
+}
+
+/**
+ * \details Counts the time from the first contact to now in its bucket and stops timing. Keys that come without a timed contact, such as repeats, are not counted.
+ */
+void phi_latency_histograms::latency_emit(unsigned long t)
+{
+  if (!latency_armed) return;
+  latency_armed=0;
+  unsigned long dt=t-latency_t0;
+  if (dt>latency_max) latency_max=dt;
+  byte b=0;
+  for (unsigned long v=dt;v&&(b<latency_buckets-1);v>>=1) b++;
+  if (latency_counts[b]<65535U) latency_counts[b]++;
+}
+#endif
+
+//Keypad class member functions:
+/*
+ __  ___  ___________    ____ .______      ___       _______  
+|  |/  / |   ____\   \  /   / |   _  \    /   \     |       \ 
+|  '  /  |  |__   \   \/   /  |  |_)  |  /  ^  \    |  .--.  |
+|    <   |   __|   \_    _/   |   ___/  /  /_\  \   |  |  |  |
+|  .  \  |  |____    |  |     |  |     /  _____  \  |  '--'  |
+|__|\__\ |_______|   |__|     | _|    /__/     \__\ |_______/ 
+*/
+/**
+ * \details Initializes the members all keypads share. Each subclass constructor still sets up its own pins and button status.
+ */
+phi_keypads::phi_keypads()
+{
+#if phi_enable_chords
+  chords=0;
+  chord_count=0;
+  chord_state=chord_idle;
+  chord_match=NO_KEYs;
+  chord_window=0;
+  chord_keys=0;
+  chord_seen=0;
+  chord_t=0;
+  chord_match_t=0;
+#endif
+#if phi_enable_slicing
+  slice=0;
+  slice_unit=0;
+  slice_mask=0;
+#endif
+#if phi_enable_key_handlers
+  handlers=0;
+  handler_count=0;
+  handlers_in_flash=0;
+#endif
+#if phi_enable_layers
+  base_names=0;
+  layers=0;
+  layer_count=0;
+  layer_mask=0;
+  layer_keys=0;
+  layer_table=0;
+#endif
+#if phi_enable_calibration
+  cal=0;
+  cal_count=0;
+  cal_reading_scan=NO_KEYs;
+#endif
+#if phi_enable_integrator
+  integrators=0;
+  integrator_keys=0;
+#endif
+  init_latency();
+#if phi_enable_background_scan
+  typed=0;
+  typed_size=0;
+  typed_head=0;
+  typed_tail=0;
+  typed_lost=0;
+  typed_status=buttons_up;
+  next_background=0;
+#endif
+}
+
+/**
+ * \details This returns the lowest scan code in a key mask, so a multi-key scan can be fed to the single key state machine.
+ * \return It returns the lowest scan code whose bit is set or NO_KEYs if the mask is empty.
+ */
+static byte lowest_key(unsigned long mask)
+{
+  if (!mask) return NO_KEYs;
+  byte key=0;
+  while (!(mask&1))
+  {
+    mask>>=1;
+    key++;
+  }
+  return key;
+}
+
+/**
+ * \details Outputs the name of the last sensed key or NO_KEY. If all you want is to  sense a key press, use getKey instead. You can use this in conjunction with get_status to sense if a key is held.
+ * \return it returns the name of the last sensed key or NO_KEY. This key may not be currently pressed.
+ */ 
+byte phi_keypads::get_sensed()
+{
+  if (button_sensed==NO_KEYs) return NO_KEY;
+  else return key_names[button_sensed];
+}
+
+/**
+ * \details Return status of the sensed key. If there is no sensed key, this return should not be used.
+ * \return It returns status of the sensed key.
+ */
+byte phi_keypads::get_status()
+{
+#if phi_enable_background_scan
+  if (typed) return typed_status; // The live status may have moved on since the key was queued.
+#endif
+  return button_status;
+}
+
+/**
+ * \details This is the public method to get a key press from the keypad. The key press is translated into key_names or NO_KEY.
+ * This function is inherited from multiple_button_inputs. All Keypad subclasses such as phi_matrix_keypads and phi_analog_keypads share this code.
+ * Since all multiple_button_inputs devices have this method, you can treat all of them as multiple_button_inputs and call this method to get a key press.
+ * This is the function you should call to sense key presses. 
+ * It is only few lines of code and is generic enough for all phi_keypads.
+ * \return It returns the name of the key that is pressed down.
+ */
+byte phi_keypads::getKey()
+{
+#if phi_enable_background_scan
+  if (typed)
+  {
+    byte tail;
+    while ((tail=typed_tail)!=typed_head)
+    {
+      byte key=typed[tail].key;
+      byte status=typed[tail].status;
+#if phi_enable_key_handlers
+      byte scan=typed[tail].scan;
+#endif
+      typed_tail=(tail+1==typed_size)?0:tail+1; // Hand the entry back to the interrupt only after it is copied.
+#if phi_enable_key_handlers
+      if (scan!=NO_KEYs) // A handler the interrupt found but left to us.
+      {
+        run_handler(scan,status);
+        continue;
+      }
+#endif
+      typed_status=status;
+      return key;
+    }
+    return NO_KEY;
+  }
+#endif
+  return scan_once();
+}
+
+/**
+ * \details This is one scan of the keypad: sense it, run the state machine and translate the scan code into a key name. getKey calls it directly, or scan_all calls it from a timer interrupt in background mode.
+ * \return It returns the name of the key that is pressed down or NO_KEY.
+ */
+byte phi_keypads::scan_once()
+{
+  byte key=NO_KEY;
+  t_now=clock_fn(); // The one clock read of this scan.
+  if (!start_scan()) return NO_KEY; // The keypad's pins belong to its LEDs this time.
+#if phi_enable_slicing
+  if (slice&&scan_units())
+  {
+    unsigned long frame;
+    if (scan_slice(&frame)) // Until the frame is complete, the state machine waits for it.
+    {
+      frame=integrate(note_raw(frame));
+#if phi_enable_chords
+      if (chord_count) key=scanChords(frame);
+      else
+#endif
+      {
+        byte scan=update_status(lowest_key(frame));
+        if (scan!=NO_KEYs) key=key_names[scan];
+      }
+    }
+  }
+  else
+#endif
+  {
+#if phi_enable_chords
+    if (chord_count) key=scanChords(integrate(note_raw(sense_mask())));
+    else
+#endif
+    {
+      byte scan=scanKeypad();
+      if (scan!=NO_KEYs) key=key_names[scan];
+    }
+  }
+  if (button_status==buttons_up) latency_drop(t_now,buttons_debounce_ticks); // A glitch that never became a key.
+  if (key!=NO_KEY) latency_emit(t_now);
+  end_scan();
+  return key;
+}
+
+#if phi_enable_background_scan
+/**
+ * \details Turns background mode on or off. In background mode the keypad is scanned by scan_all(), usually from a timer interrupt, and getKey only takes keys out of the type-ahead buffer, so keys pressed while the loop is busy are not lost.
+ * The buffer holds size-1 keys. When it is full, further keys are counted by get_lost and thrown away.
+ * Only sensing and the state machine run in the interrupt. Key handlers (set_handlers) are queued with the keys and called from getKey, so they take buffer entries too. Analog calibration (set_calibration) is used but not nudged toward new readings in background mode.
+ * Interrupts are off while the interrupt scans, so only keypads whose sensing never waits are accepted. On a 16MHz AVR the longest scan is about 5us per key plus 10us per column on phi_matrix_keypads, about 100us for a 4*4 pad, and 5us per button on phi_button_groups.
+ * phi_joysticks and phi_analog_keypads take about 10us per analog pin, but only once every pin is scheduled with phi_adc_schedulers, since a conversion of their own takes 112us and a joystick also waits 5ms for each axis to settle. They are refused otherwise.
+ * phi_liudr_keypads and phi_liudr_keypads_2 are always refused. A scan shifts out or converts every column, about 2ms, which is longer than the timer period and would lose millis() updates.
+ * Interrupts are left as they were, so this can be called with them off.
+ * \param buf This is the type-ahead buffer, such as phi_typed_keys typed[16].
+ * \param size This is the number of entries in buf, 2 to 255. Pass 0 to go back to scanning in getKey.
+ * \return It returns 1 if the keypad is now in background mode, or 0 if it scans in getKey, because size was 0 or because its sensing waits.
+ */
+byte phi_keypads::set_background(phi_typed_keys *buf, byte size)
+{
+  byte on=buf&&(size>1)&&!sense_blocks();
+#if defined(__AVR__)
+  byte sreg=SREG; // A pointer takes two stores on AVR, so the interrupt must not run between them.
+  cli();
+#endif
+  phi_keypads **link=&background_list; // Take this keypad out of the list first, so it is never in it twice.
+  while (*link&&(*link!=this)) link=&((*link)->next_background);
+  if (*link) *link=next_background;
+  __atomic_signal_fence(__ATOMIC_SEQ_CST); // Elsewhere a pointer is one store, so order the stores instead of turning interrupts off: the interrupt stops seeing this keypad before it changes...
+  next_background=0;
+  if (on)
+  {
+    typed=buf;
+    typed_size=size;
+    typed_head=typed_tail=0;
+    typed_lost=0;
+    next_background=background_list;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST); // ...and sees it again only once it is ready.
+    background_list=this;
+  }
+  else typed=0;
+#if defined(__AVR__)
+  SREG=sreg;
+#endif
+  return on;
+}
+
+/**
+ * \details Scans every keypad in background mode once and queues the keys they report. Call it at a fixed rate from a timer interrupt, such as every 1 to 10ms, or let begin_timer() do it on AVR.
+ * Debounce, hold and repeat times still run on the library's clock, so the rate only needs to be fast enough to see every bounce settle.
+ */
+void phi_keypads::scan_all()
+{
+  for (phi_keypads *pad=background_list;pad;pad=pad->next_background) pad->scan_background();
+}
+
+/**
+ * \details Scans this keypad once and adds the key it reports to the type-ahead buffer.
+ */
+void phi_keypads::scan_background()
+{
+  byte key=scan_once();
+  if (key!=NO_KEY) push_typed(key,button_status,NO_KEYs);
+}
+
+/**
+ * \details Adds an entry to the type-ahead buffer. This is the only writer of typed_head.
+ * \param key This is the key name, or NO_KEY for a handler call.
+ * \param status This is the status of the key, or the event for a handler call.
+ * \param scan This is NO_KEYs for a key, or the scan code whose handler getKey should call.
+ */
+void phi_keypads::push_typed(byte key, byte status, byte scan)
+{
+  byte head=typed_head;
+  byte next=(head+1==typed_size)?0:head+1;
+  if (next==typed_tail) // Full. Keep the keys already typed and drop the new one.
+  {
+    if (typed_lost<255) typed_lost++;
+    return;
+  }
+  typed[head].key=key;
+  typed[head].status=status;
+#if phi_enable_key_handlers
+  typed[head].scan=scan;
+#else
+  (void)scan; // Only handler calls are queued with a scan code.
+#endif
+  typed_head=next; // Publish the entry only after it is written.
+}
+
+/**
+ * \details Starts calling scan_all() from the timer 0 compare B interrupt. Timer 0 already runs millis() and overflows about every 1.024ms, so the compare interrupt comes at the same rate without changing the timer, and millis(), delay() and PWM on pins 5 and 6 keep working.
+ * The compare value is left alone, since it is the duty cycle of analogWrite on pin 5 (OC0B). Whatever it is, the timer passes it once per cycle, so it only moves the interrupt within the cycle.
+ * On other boards, or with keypad_timer_isr set to 0, this does nothing. Call scan_all() from a timer of your own instead.
+ * \param ms This is the number of timer interrupts, about 1ms each, between scans.
+ */
+void phi_keypads::begin_timer(byte ms)
+{
+  timer_ms=ms?ms:1;
+  timer_count=0;
+#if keypad_timer_isr && defined(__AVR__) && defined(TIMSK0) && defined(OCIE0B)
+  TIMSK0|=(1<<OCIE0B);
+#endif
+}
+
+/**
+ * \details Stops the interrupt started by begin_timer(). Keypads stay in background mode, so call scan_all() some other way or turn background mode off with set_background.
+ */
+void phi_keypads::end_timer()
+{
+#if keypad_timer_isr && defined(__AVR__) && defined(TIMSK0) && defined(OCIE0B)
+  TIMSK0&=~(1<<OCIE0B);
+#endif
+}
+
+/**
+ * \details Called by the timer interrupt. Calls scan_all() once every timer_ms calls.
+ */
+void phi_keypads::timer_tick()
+{
+  if (++timer_count<timer_ms) return;
+  timer_count=0;
+  scan_all();
+}
+
+#if keypad_timer_isr && defined(__AVR__) && defined(TIMER0_COMPB_vect)
+ISR(TIMER0_COMPB_vect)
+{
+  phi_keypads::timer_tick();
+}
+#endif
+#endif
+
+/**
+ * \details This routine uses senseAll to scan the keypad, use debouncing to update button_sensed and button_status.
+ * This function is not intended to be call by arduino code but called within the library instead.
+ * If all you want is a key press, call getKey.
+ * The getKey calls this function and translates keypress from scan code (0 to max_key-1) into characters or key names.
+ * \return This function only returns scan code (0 to max_key-1).
+ */
+byte phi_keypads::scanKeypad()
+{
+  if (integrating()) return update_status(lowest_key(integrate(note_raw(sense_mask())))); // Every key needs its own counter, so sense them all.
+  byte scan=sense_all();
+  latency_sample(scan!=NO_KEYs,t_now);
+  return update_status(scan);
+}
+
+/**
+ * \details This is the debounce and repeat state machine behind scanKeypad. It takes one scan result and updates button_sensed and button_status.
+ * Keeping it separate from sensing lets scanChords feed it keys taken from a multi-key scan without scanning twice.
+ * \param button_pressed This is the scan code sensed in this scan or NO_KEYs.
+ * \return This function only returns scan code (0 to max_key-1) or NO_KEYs.
+ */
+byte phi_keypads::update_status(byte button_pressed)
+{
+  switch (button_status)
+  {
+    case buttons_up:
+    if (button_pressed!=NO_KEYs)
+    {
+      button_sensed=button_pressed;
+      button_status_t=t_now;
+      button_status=buttons_debounce;
+      if (integrating()) return update_status(button_pressed); // Already debounced, so confirm it on this scan.
+    }
+    else button_sensed=NO_KEYs;
+    break;
+    
+    case buttons_debounce:
+    if (button_pressed!=NO_KEYs)
+    {
+      if (button_sensed==button_pressed)
+      {
+        if (integrating()||(t_now-button_status_t>buttons_debounce_ticks))
+        {
+          button_status=buttons_pressed;
+          button_status_t=t_now;
+          t_last_action=button_status_t;
+          key_confirmed(button_sensed);
+          dispatch(button_sensed,buttons_pressed);
+          return button_sensed;
+        }
+      }
+      else
+      {
+        button_status_t=t_now;
+        button_sensed=button_pressed;
+        if (integrating()) return update_status(button_pressed);
+      }
+    }
+    else
+    {
+      button_status=buttons_up;
+      button_sensed=NO_KEYs;
+    }
+    break;
+    
+    case buttons_pressed:
+    if (button_pressed!=NO_KEYs)
+    {
+      if (button_sensed==button_pressed) button_status=buttons_down;
+      else button_status=buttons_debounce;
+      button_status=buttons_down;
+    }
+    else
+    {
+      button_status=buttons_released;
+      dispatch(button_sensed,buttons_released);
+    }
+    button_status_t=t_now;
+    break;
+    
+    case buttons_down:
+    if (button_sensed==button_pressed)
+    {
+      if (t_now-button_status_t>buttons_hold_ticks)
+      {
+        button_status=buttons_held;
+        button_status_t=t_now;
+        dispatch(button_sensed,buttons_held);
+      }
+    }
+    else
+    {
+      button_status=buttons_released;
+      button_status_t=t_now;
+      dispatch(button_sensed,buttons_released);
+    }
+    break;
+    
+    case buttons_released:
+    if (button_pressed==NO_KEYs) button_status=buttons_up;
+    else
+    {
+      button_status=buttons_debounce;
       button_sensed=button_pressed;
-      button_status_t=millis();
+      button_status_t=t_now;
+      if (integrating()) return update_status(button_pressed);
+    }
+    break;
+    
+    case buttons_held:
+    if (button_sensed!=button_pressed)
+    {
+      button_status=buttons_released;
+      button_status_t=t_now;
+      dispatch(button_sensed,buttons_released);
+      return button_sensed;
+    }
+    else if (t_now-button_status_t>repeat_interval())
+    {
+      button_status_t=t_now;
+      dispatch(button_sensed,buttons_repeated);
+      return button_sensed;
+    }
+    break;
+  }
+  return NO_KEYs;
+}
+
+#if phi_enable_chords
+/**
+ * \details This sets up chords, combinations of keys that are pressed together and reported as one key, such as shift+1.
+ * When a key that belongs to any chord goes down, it is held back for up to window ms. If the keys down then match a chord for the debounce time, the chord name is returned once and the chord's keys report nothing else until they are all released.
+ * If the keys are released within the window, the single key is reported as a tap. If the window runs out, the key is handled as a normal key with hold and repeat.
+ * Keys that are not part of any chord are not delayed. The keypad needs to sense several keys at once, see sense_mask.
+ * \param ch This is the name of (or pointer to) an array of phi_chords. The array is not copied so it needs to stay around.
+ * \param n This is the number of chords in the array. Use 0 to turn chords off.
+ * \param window This is how long in ms a chord key is held back waiting for the rest of the chord. 50 to 100ms works for most people.
+
+ * Example:
+
+phi_chords my_chords[]={{(1UL<<0)|(1UL<<3),'X'},{(1UL<<0)|(1UL<<7),'Y'}}; // Scan codes 0+3 return 'X' and 0+7 return 'Y'.
+
+panel_keypad.set_chords(my_chords, 2, 80);
+ */
+void phi_keypads::set_chords(phi_chords *ch, byte n, unsigned int window)
+{
+  chords=ch;
+  chord_count=n;
+  chord_window=window;
+  chord_state=chord_idle;
+  chord_match=NO_KEYs;
+  chord_keys=0;
+  for (byte i=0;i<n;i++) chord_keys|=chords[i].mask;
+}
+#endif
+
+#if phi_enable_integrator
+/**
+ * \details This turns on integrating debounce, which replaces the debounce time. Each key gets a counter that goes up by one on every scan that finds the key down and down by one on every scan that finds it up, staying between 0 and max.
+ * The key counts as down once its counter reaches on and as up again once it falls to off. A noisy sample only moves the counter back by one instead of restarting the wait, so a contact that chatters is still recognized after a few extra scans.
+ * Debouncing then costs the same fixed work on every scan and reads no clock. How long a press takes to register is on scans times the time between scans. Hold and repeat still run on the clock.
+ * Every key needs its own counter, so the keypad is sensed with sense_mask on each scan and only scan codes 0-31 are debounced.
+ * \param counters This is an array with one byte per key. The library keeps the counters and the debounced state in it.
+ * \param keys This is the number of entries in counters. Use 0 to go back to debouncing with the debounce time.
+ * \param on This is the count at which a key becomes down.
+ * \param off This is the count at which a key becomes up again. It needs to be less than on.
+ * \param max This is the highest count, up to 127. Raising it above on makes a long press ride out longer gaps at the cost of a slower release.
+
+ * Example:
+
+byte counters[16];
+panel_keypad.set_integrator(counters, 16, 4, 1, 5); // Down after 4 more down than up scans, up after falling back to 1.
+ */
+void phi_keypads::set_integrator(byte *counters, byte keys, byte on, byte off, byte max)
+{
+  if ((!counters)||(!keys)||(off>=on)||(on>max)||(max>integrator_count_max))
+  {
+    integrators=0;
+    integrator_keys=0;
+    return;
+  }
+  if (keys>32) keys=32;
+  for (byte i=0;i<keys;i++) counters[i]=0;
+  integrator_on=on;
+  integrator_off=off;
+  integrator_max=max;
+  integrator_keys=keys;
+  integrators=counters;
+}
+
+/**
+ * \details Steps every key's counter with one scan and returns the keys that are down after debouncing. The top bit of each counter holds the debounced state so the thresholds can have a gap between them.
+ * \param mask This is the keys found down by this scan, bit n for scan code n.
+ * \return It returns the debounced keys down, or mask itself if integrating debounce is off.
+ */
+unsigned long phi_keypads::integrate(unsigned long mask)
+{
+  if (!integrators) return mask;
+  unsigned long down=0;
+  for (byte i=0;i<integrator_keys;i++)
+  {
+    byte state=integrators[i]&integrator_down;
+    byte count=integrators[i]&integrator_count_max;
+    if (mask&(1UL<<i))
+    {
+      if (count<integrator_max) count++;
+    }
+    else if (count) count--;
+    if (count>=integrator_on) state=integrator_down;
+    else if (count<=integrator_off) state=0;
+    integrators[i]=state|count;
+    if (state) down|=1UL<<i;
+  }
+  return down;
+}
+#endif
+
+#if phi_enable_slicing
+/**
+ * \details This turns on time-sliced scanning. Each getKey then senses at most units columns (matrix and liudr pads) or analog pins (analog keypads) and picks up where the last call left off.
+ * When the last unit of the keypad is sensed, the keys found over the whole frame go through debouncing, chords and repeat like a full scan. Calls that don't finish a frame return NO_KEY without touching the key status.
+ * The worst-case cost of one getKey is units times the cost of one unit plus one run of the state machine. At 16MHz one unit costs about:
+ * phi_matrix_keypads: two digitalWrites and one digitalRead per row, around 5us per row.
+ * phi_liudr_keypads: one 16-bit shift out and one digitalRead per row, around 250us.
+ * phi_liudr_keypads_2: re-arming the column pins and one analog conversion, around 130us plus 10us per column.
+ * phi_analog_keypads: one analog conversion, around 112us, or a table load if the pin is scheduled with phi_adc_schedulers.
+ * A frame takes scan_units/units calls, so call getKey often enough that a frame is shorter than the debounce time. Keypads that can't be sliced, such as button groups and joysticks, keep scanning whole.
+ * Sliced frames are multi-key scans, so like sense_mask they report scan codes 0-31.
+ * \param units This is the number of units per call. Use 0 to go back to full scans.
+
+ * Example:
+
+panel_keypad.set_slice(1); // One column per getKey.
+ */
+void phi_keypads::set_slice(byte units)
+{
+  slice=units;
+  slice_unit=0;
+  slice_mask=0;
+}
+#endif
+
+#if phi_enable_key_handlers
+/**
+ * \details This registers a key handler table. After each scan, the handler of a key is called straight from the state machine when the key is pressed, held, repeats or is released, if its entry asks for that event.
+ * Finding the handler is one indexed load by scan code, so many keys and devices don't slow it down. getKey still returns keys as before, so handlers and polling can be mixed. Chords are only returned by getKey.
+ * The table is not copied so it needs to stay around. Use set_handlers_P for a table in PROGMEM.
+ * \param table This is the name of (or pointer to) an array of phi_key_handlers with one entry per scan code.
+ * \param n This is the number of entries in the table. Use 0 to turn handlers off. Scan codes past the table have no handler.
+
+ * Example:
+
+void on_digit(byte key, byte event) {Serial.write(key);}
+void on_enter(byte key, byte event) {if (event==buttons_released) Serial.println();}
+phi_key_handlers my_handlers[]={{on_digit,event_pressed|event_repeated},{on_digit,event_pressed|event_repeated},{on_enter,event_released}};
+
+panel_keypad.set_handlers(my_handlers, 3);
+ */
+void phi_keypads::set_handlers(const phi_key_handlers *table, byte n)
+{
+  handlers=table;
+  handler_count=n;
+  handlers_in_flash=0;
+}
+
+/**
+ * \details This registers a key handler table stored in PROGMEM, so a table that never changes takes no RAM. See set_handlers.
+ * \param table This is the name of (or pointer to) an array of phi_key_handlers declared with PROGMEM.
+ * \param n This is the number of entries in the table. Use 0 to turn handlers off.
+
+ * Example:
+
+const phi_key_handlers my_handlers[] PROGMEM={{on_digit,event_pressed},{on_digit,event_pressed},{on_enter,event_released}};
+
+panel_keypad.set_handlers_P(my_handlers, 3);
+ */
+void phi_keypads::set_handlers_P(const phi_key_handlers *table, byte n)
+{
+  handlers=table;
+  handler_count=n;
+  handlers_in_flash=1;
+}
+#endif
+
+#if phi_enable_layers
+/**
+ * \details This sets up keymap layers, such as a numeric layer and a navigation layer on top of the mapping array given to the constructor.
+ * Each layer is a char array in PROGMEM with one name per scan code. KEY_TRANSPARENT in a layer lets the key fall through to the next layer down that is on, and finally to the constructor's mapping.
+ * Whenever the layers that are on change, every key is resolved once into table, and getKey, get_sensed and the handlers read names from there. So a key lookup is still one indexed load no matter how many layers there are.
+ * All layers start off. The arrays are not copied so they need to stay around.
+ * \param layer_tables This is an array of pointers to the layers, layer 0 first. Higher layers win over lower ones. At most layers_max layers.
+ * \param n This is the number of layers. Use 0 to go back to the constructor's mapping.
+ * \param table This is a char array in RAM with one element per key. The active keymap is compiled into it.
+ * \param keys This is the number of keys, the length of table and of each layer.
+
+ * Example:
+
+const char numeric[] PROGMEM={'1','2','3',KEY_TRANSPARENT,'4','5','6',KEY_TRANSPARENT,'7','8','9',KEY_TRANSPARENT,'*','0','#',KEY_TRANSPARENT};
+const char navigation[] PROGMEM={KEY_TRANSPARENT,'U',KEY_TRANSPARENT,KEY_TRANSPARENT,'L','E','R',KEY_TRANSPARENT,KEY_TRANSPARENT,'D',KEY_TRANSPARENT,KEY_TRANSPARENT,KEY_TRANSPARENT,KEY_TRANSPARENT,KEY_TRANSPARENT,KEY_TRANSPARENT};
+const char * const my_layers[]={numeric, navigation};
+char my_keymap[16];
+
+panel_keypad.set_layers(my_layers, 2, my_keymap, 16);
+panel_keypad.layer_on(1); // Navigation on top, other keys from the constructor's mapping.
+ */
+void phi_keypads::set_layers(const char * const *layer_tables, byte n, char *table, byte keys)
+{
+  if (!base_names) base_names=key_names;
+  if (n>layers_max) n=layers_max;
+  layers=layer_tables;
+  layer_count=n;
+  layer_table=table;
+  layer_keys=keys;
+  if (!n)
+  {
+    key_names=base_names;
+    layer_mask=0;
+    return;
+  }
+  set_layer_mask(layer_mask);
+}
+
+/**
+ * \details This turns on the layers whose bits are set, such as 1<<2 for layer 2 only, and compiles the keymap. The work is done here once, not on every key.
+ * \param mask This is the bit mask of layers to turn on. Bits past the number of layers are ignored.
+ */
+void phi_keypads::set_layer_mask(byte mask)
+{
+  if (!layer_count) return;
+  if (layer_count<8) mask&=(1<<layer_count)-1;
+  layer_mask=mask;
+  for (byte k=0;k<layer_keys;k++)
+  {
+    char name=base_names[k];
+    for (signed char l=layer_count-1;l>=0;l--)
+    {
+      if (!(mask&(1<<l))) continue;
+      char layer_name=(char)pgm_read_byte(layers[l]+k);
+      if (layer_name!=KEY_TRANSPARENT)
+      {
+        name=layer_name;
+        break;
+      }
+    }
+    layer_table[k]=name;
+  }
+  key_names=layer_table;
+}
+#endif
+
+#if phi_enable_calibration
+/**
+ * \details This turns on per-key calibration for analog keypads (phi_analog_keypads and phi_liudr_keypads_2). Instead of the values given to the constructor and the fixed analog_difference, each key is matched against its own center and tolerance in table.
+ * The table is filled from the constructor's values, so nothing changes until keys are calibrated with calibrate_key or a saved calibration is loaded with set_calibration_blob.
+ * While calibration is on, every confirmed press moves that key's center 1/4 of the way toward the reading, so slow drift from supply voltage or temperature is followed without recalibrating.
+ * \param table This is a RAM array of phi_analog_cal with one entry per scan code. It is not copied so it needs to stay around.
+ * \param n This is the number of entries. Use 0 to turn calibration off. Keys past the table use the constructor's values.
+
+ * Example:
+
+phi_analog_cal my_cal[5];
+
+panel_keypad.set_calibration(my_cal, 5);
+ */
+void phi_keypads::set_calibration(phi_analog_cal *table, byte n)
+{
+  cal=table;
+  cal_count=n;
+  cal_reading_scan=NO_KEYs;
+  for (byte k=0;k<n;k++)
+  {
+    byte tol;
+    int val=key_value(k,&tol);
+    cal[k].center=(val<0)?0:val;
+    cal[k].tolerance=tol;
+    cal[k].measured=tol;
+  }
+}
+
+/**
+ * \details This measures a key while it is held down, such as from a calibration screen that asks the user to hold each key in turn. It blocks for samples conversions.
+ * The center is the average of fresh conversions, not of samples phi_adc_schedulers already filtered. The tolerance is twice the spread of the readings plus analog_cal_min_tolerance, cut down to less than half the distance to the nearest key read on the same pin or column so two keys never overlap.
+ * \param scan This is the scan code of the key being held.
+ * \param samples This is how many readings to take, such as 32.
+ * \return It returns 1 if the key was calibrated, or 0 if calibration is off, the keypad isn't analog, the readings were too unsteady (more than analog_cal_max_spread apart), or they are closer to another key on the same pin than to this one, for example because the key wasn't held.
+ */
+byte phi_keypads::calibrate_key(byte scan, byte samples)
+{
+  if ((scan>=cal_count)||(!samples)) return 0;
+  long sum=0;
+  int lo=1023, hi=0;
+  for (byte n=0;n<samples;n++)
+  {
+    int raw=read_key_raw(scan);
+    if (raw<0) return 0;
+    sum+=raw;
+    if (raw<lo) lo=raw;
+    if (raw>hi) hi=raw;
+  }
+  if (hi-lo>analog_cal_max_spread) return 0;
+  int center=(sum+samples/2)/samples;
+  int tol=2*(hi-lo)+analog_cal_min_tolerance;
+  for (byte k=0;k<cal_count;k++)
+  {
+    if ((k==scan)||(key_channel(k)!=key_channel(scan))) continue;
+    if (abs(cal[k].center-center)<abs(cal[scan].center-center)) return 0; // Closer to another key, so this key is probably not the one held.
+  }
+  cal[scan].center=center;
+  cal[scan].measured=(tol>255)?255:tol;
+  separate_keys(scan);
+  return 1;
+}
+
+/**
+ * \details This sets the tolerance of every key read on the same pin or column as scan to the tolerance it was calibrated with, cut to less than half the distance to the nearest center, so no reading can match two keys. It is called whenever a center moves, so a tolerance cut while two keys drifted close grows back once they move apart.
+ * \param scan This is the scan code of the key whose center moved.
+ */
+void phi_keypads::separate_keys(byte scan)
+{
+  byte channel=key_channel(scan);
+  for (byte k=0;k<cal_count;k++)
+  {
+    if (key_channel(k)!=channel) continue;
+    int tol=cal[k].measured;
+    for (byte j=0;j<cal_count;j++)
+    {
+      if ((j==k)||(key_channel(j)!=channel)) continue;
+      int half=abs(cal[j].center-cal[k].center)/2;
+      if (tol>half-1) tol=(half>0)?half-1:0;
+    }
+    cal[k].tolerance=tol;
+  }
+}
+
+/**
+ * \details This matches an analog reading against a key. With calibration on, the key's own center and tolerance are used. Otherwise the reading is compared with the expected value like before.
+ * \param scan This is the scan code of the key.
+ * \param temp This is the reading.
+ * \param expected This is the value from the constructor.
+ * \param diff This is the uncalibrated tolerance, such as analog_difference. A match needs to be closer than this.
+ * \return It returns 1 if the reading matches the key.
+ */
+byte phi_keypads::cal_match(byte scan, int temp, int expected, int diff)
+{
+  if (scan<cal_count)
+  {
+    if (abs(cal[scan].center-temp)>cal[scan].tolerance) return 0;
+    cal_reading=temp; // Kept for key_confirmed, so tracking needs no conversion of its own.
+    cal_reading_scan=scan;
+    return 1;
+  }
+  return abs(expected-temp)<diff;
+}
+
+/**
+ * \details This is called when a press is confirmed. With calibration on, the key's center moves 1/4 of the way, at least by 1, toward the reading the scan matched it with, and the keys on its pin or column are kept apart with separate_keys.
+ * Only a reading that matched this key within its tolerance is used, so one bad sample doesn't move the key. If the scan last matched a different key, such as on a multi-key scan, the center stays put this time.
+ * \param scan This is the scan code of the key.
+ */
+void phi_keypads::key_confirmed(byte scan)
+{
+  if (scan>=cal_count) return;
+#if phi_enable_background_scan
+  if (typed) return; // Not from the interrupt.
+#endif
+  if (cal_reading_scan!=scan) return;
+  cal_reading_scan=NO_KEYs;
+  int d=cal_reading-cal[scan].center;
+  if (!d) return;
+  if (d>0) cal[scan].center+=(d+3)/4;
+  else cal[scan].center-=(-d+3)/4;
+  separate_keys(scan);
+}
+
+/**
+ * \details This copies the calibration table into a byte array that you can save in EEPROM, one byte at a time or with EEPROM.put. The array holds the number of keys, 3 bytes per key (center and calibrated tolerance) and a CRC-8.
+ * \param buf This is the array to fill.
+ * \param size This is the size of buf. It needs 3 bytes per key plus 2.
+ * \return It returns the number of bytes used, or 0 if calibration is off or buf is too small.
+ */
+byte phi_keypads::get_calibration_blob(byte *buf, byte size)
+{
+  if ((!cal_count)||(size<cal_count*3+2)) return 0;
+  byte n=0;
+  buf[n++]=cal_count;
+  for (byte k=0;k<cal_count;k++)
+  {
+    buf[n++]=cal[k].center&0xFF;
+    buf[n++]=cal[k].center>>8;
+    buf[n++]=cal[k].measured;
+  }
+  byte crc=0;
+  for (byte i=0;i<n;i++) crc=crc8_update(crc,buf[i]);
+  buf[n++]=crc;
+  return n;
+}
+
+/**
+ * \details This loads a calibration saved with get_calibration_blob into the table given to set_calibration. Call set_calibration first. A blob for a different number of keys, or one that fails the CRC, such as blank EEPROM, is rejected and the table is left alone.
+ * \param buf This is the saved array.
+ * \param size This is the size of buf.
+ * \return It returns 1 if the calibration was loaded.
+ */
+byte phi_keypads::set_calibration_blob(const byte *buf, byte size)
+{
+  if ((!cal_count)||(size<cal_count*3+2)||(buf[0]!=cal_count)) return 0;
+  byte n=cal_count*3+1;
+  byte crc=0;
+  for (byte i=0;i<n;i++) crc=crc8_update(crc,buf[i]);
+  if (crc!=buf[n]) return 0;
+  for (byte k=0;k<cal_count;k++)
+  {
+    cal[k].center=buf[k*3+1]|(buf[k*3+2]<<8);
+    cal[k].measured=buf[k*3+3];
+  }
+  for (byte k=0;k<cal_count;k++) separate_keys(k);
+  return 1;
+}
+#endif
+
+#if phi_enable_key_handlers
+/**
+ * \details Calls the handler of a key if it has one and it wants this event. This is called from the state machine and not intended to be called by arduino code.
+ * \param scan This is the scan code of the key.
+ * \param event This is the event, such as buttons_pressed or buttons_repeated.
+ */
+void phi_keypads::dispatch(byte scan, byte event)
+{
+#if phi_enable_background_scan
+  if (typed) // In the interrupt. Leave the call to getKey.
+  {
+    if (run_handler(scan,event,0)) push_typed(NO_KEY,event,scan);
+    return;
+  }
+#endif
+  run_handler(scan,event);
+}
+
+/**
+ * \details Looks up the handler of a key and calls it if it wants this event.
+ * \param scan This is the scan code of the key.
+ * \param event This is the event, such as buttons_pressed or buttons_repeated.
+ * \param call This is 0 to only look.
+ * \return It returns 1 if the key has a handler for this event.
+ */
+byte phi_keypads::run_handler(byte scan, byte event, byte call)
+{
+  if (scan>=handler_count) return 0; // Also covers no table and NO_KEYs.
+  void (*handler)(byte key, byte event);
+  byte events;
+#if defined(__AVR__)
+  if (handlers_in_flash)
+  {
+    handler=(void (*)(byte, byte))pgm_read_word(&handlers[scan].handler);
+    events=pgm_read_byte(&handlers[scan].events);
+  }
+  else
+#endif
+  {
+    handler=handlers[scan].handler;
+    events=handlers[scan].events;
+  }
+  if (!(handler&&(events&(1<<event)))) return 0;
+  if (call) handler(key_names[scan],event);
+  return 1;
+}
+#endif
+
+#if phi_enable_slicing
+/**
+ * \details Senses the next slice of units and adds their keys to the frame being collected. A call stops early at the end of a frame, so it never senses more than slice units.
+ * \param frame This receives the keys of the whole frame, filtered by end_frame, when the frame completes.
+ * \return It returns 1 if the frame is complete or 0 if more calls are needed.
+ */
+byte phi_keypads::scan_slice(unsigned long *frame)
+{
+  byte units=scan_units();
+  for (byte n=0;n<slice;n++)
+  {
+    if (slice_unit>=units) slice_unit=0; // In case the keypad shrank.
+    slice_mask|=sense_unit(slice_unit);
+    slice_unit++;
+    if (slice_unit>=units)
+    {
+      *frame=end_frame(slice_mask);
+      slice_unit=0;
+      slice_mask=0;
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+/**
+ * \details This senses all input pins and returns all keys that are down as a bit mask. Bit n is set if scan code n is down.
+ * This default only knows about the one key sense_all returns. Keypads that can sense several keys at once replace it. Only scan codes 0-31 fit in the mask.
+ * \return It returns the bit mask of keys that are down or 0 if no key is down.
+ */
+unsigned long phi_keypads::sense_mask()
+{
+  byte button_pressed=sense_all();
+  if (button_pressed>=32) return 0;
+  return 1UL<<button_pressed;
+}
+
+#if phi_enable_chords
+/**
+ * \details This is the chord version of scanKeypad, called by getKey when chords are registered, with all keys sensed once by sense_mask or a sliced frame.
+ * Each chord is matched with a single mask compare. Keys of a pending chord are held back. Keys outside all chords go through the regular state machine.
+ * \param mask This is the bit mask of keys that are down.
+ * \return Unlike scanKeypad, this returns a key name (chord or single key) or NO_KEY since chords have no scan code.
+ */
+byte phi_keypads::scanChords(unsigned long mask)
+{
+  byte key;
+  unsigned long own=mask&chord_keys; // Only keys that belong to a chord are held back. The rest go to the state machine as usual.
+  switch (chord_state)
+  {
+    case chord_idle:
+    if (own&&(button_status==buttons_up))
+    {
+      chord_state=chord_pending;
+      chord_seen=own;
+      chord_match=NO_KEYs;
+      chord_t=t_now;
+      mask&=~chord_keys;
     }
     break;
-    
-    case buttons_held:
-    if (button_sensed!=button_pressed)
+
+    case chord_pending:
+    chord_seen|=own;
+    mask&=~chord_keys;
+    if (!own) // Released before any chord matched: a tap on a single key is reported, a glitch or a broken chord is not.
     {
-      button_status=buttons_released;
-      button_status_t=millis();
-      return button_sensed;
+      chord_state=chord_idle;
+      key=lowest_key(chord_seen);
+      if ((chord_seen==(1UL<<key))&&(t_now-chord_t>buttons_debounce_ticks))
+      {
+        t_last_action=t_now;
+        dispatch(key,buttons_pressed); // A tap is a press and a release in one go.
+        dispatch(key,buttons_released);
+        return key_names[key];
+      }
+      break;
     }
-    else if (millis()-button_status_t>buttons_repeat_time)
+    for (key=0;(key<chord_count)&&(own!=chords[key].mask);key++);
+    if (key<chord_count)
     {
-      button_status_t=millis();
-      return button_sensed;
+      if (chord_match!=key)
+      {
+        chord_match=key;
+        chord_match_t=t_now;
+      }
+      else if (t_now-chord_match_t>buttons_debounce_ticks)
+      {
+        chord_state=chord_fired;
+        t_last_action=t_now;
+        return chords[key].name;
+      }
+      break;
+    }
+    chord_match=NO_KEYs;
+    if (t_now-chord_t>(unsigned long)chord_window*ticks_per_ms) // No chord. Hand the key to the normal state machine, already past debounce since it was down for the whole window.
+    {
+      chord_state=chord_passed;
+      mask|=own;
+      if (button_status==buttons_up) // Unless a key outside the chords got there first.
+      {
+        button_sensed=lowest_key(mask);
+        button_status=buttons_debounce;
+        button_status_t=chord_t;
+      }
     }
     break;
+
+    case chord_fired:
+    if (!own) chord_state=chord_idle;
+    mask&=~chord_keys;
+    break;
+
+    case chord_passed:
+    if (!own) chord_state=chord_idle;
+    break;
   }
-  return NO_KEYs;
+  key=update_status(lowest_key(mask));
+  if (key==NO_KEYs) return NO_KEY;
+  return key_names[key];
 }
+#endif
+
+#endif
 
+#if phi_enable_joysticks
 //Joystick class member functions
 /*
        __    ______   ____    ____  _______.___________. __    ______  __  ___
@@ -574,9 +2106,16 @@ phi_joysticks::phi_joysticks(char *na, byte *sp, int * dp, int th)
   rows=2;
   columns=3;
   threshold=th;
+  proportional=0;
+  deadzone=0;
+  deflection=0;
+  centers[0]=values[1];
+  centers[1]=values[columns+1];
+  norm_vals[0]=0;
+  norm_vals[1]=0;
   button_sensed=NO_KEYs; // This indicates which button is sensed or 255 if no button is sensed.
   button_status=buttons_up; // This indicates the status of the button if button_sensed is not 255.
-  button_status_t=millis(); // This is the time stamp of the sensed button first in the status stored in button_status.
+  button_status_t=clock_now(); // This is the time stamp of the sensed button first in the status stored in button_status.
   
   for (int j=0;j<rows;j++) // Setting sensing rows to input and disabling internal pull-up resistors.
   {
@@ -598,9 +2137,10 @@ byte phi_joysticks::sense_all()
   diff[1]=NO_KEYs;
   for (byte i=0;i<rows;i++)
   {
-    axis_vals[i]=analogRead(mySensorPins[i]);
-    delay(5);
+    axis_vals[i]=phi_analog_read(mySensorPins[i]);
+    if (!phi_adc_schedulers::has_pin(mySensorPins[i])) delay(5); // Let the multiplexer settle. Scheduled pins already settled in the background.
   }
+  if (proportional) return sense_proportional();
   for (byte j=0;j<rows;j++)
   {
     for (byte i=0;i<columns;i++)
@@ -612,6 +2152,115 @@ byte phi_joysticks::sense_all()
   else return (diff[0]*columns+diff[1]);
 }
 
+#if phi_enable_background_scan
+/**
+ * \details An axis that isn't scheduled is read with a conversion of its own and a 5ms settle delay, neither of which can be waited for in an interrupt.
+ * \return It returns 1 if an axis pin is not scheduled with phi_adc_schedulers.
+ */
+byte phi_joysticks::sense_blocks()
+{
+  for (byte i=0;i<rows;i++) if (!phi_adc_schedulers::has_pin(mySensorPins[i])) return 1;
+  return 0;
+}
+#endif
+
+/**
+ * \details This turns proportional mode on or off. The center starts as the middle value of each axis given to the constructor. Call calibrate_center for a measured center.
+ * \param on This is 1 to turn proportional mode on or 0 to go back to matching the three values per axis.
+ * \param dz This is the radius of the deadzone in normalized units, where full deflection is 127. 20 is a good start for cheap sticks.
+ */
+void phi_joysticks::set_proportional(byte on, byte dz)
+{
+  proportional=on;
+  deadzone=(dz>126)?126:dz;
+}
+
+/**
+ * \details This reads both axes a few times with the stick released and takes the averages as the center. Call it in setup().
+ */
+void phi_joysticks::calibrate_center()
+{
+  for (byte j=0;j<rows;j++)
+  {
+    long sum=0;
+    for (byte n=0;n<4;n++) sum+=phi_adc_schedulers::read_blocking(mySensorPins[j]);
+    centers[j]=sum/4;
+  }
+}
+
+/**
+ * \details Integer square root, enough for the length of a normalized stick vector.
+ */
+static unsigned int isqrt(unsigned long v)
+{
+  unsigned long root=0;
+  unsigned long bit=1UL<<30;
+  while (bit>v) bit>>=2;
+  while (bit)
+  {
+    if (v>=root+bit)
+    {
+      v-=root+bit;
+      root=(root>>1)+bit;
+    }
+    else root>>=1;
+    bit>>=2;
+  }
+  return root;
+}
+
+/**
+ * \details This is the proportional version of the direction sensing. Each axis is normalized to -127 to 127 from the calibrated center toward the end values given to the constructor, so it works whichever way the values run.
+ * The deadzone is round: nothing is reported while the stick vector is shorter than deadzone, and past it the vector is rescaled so it grows from 0 without a jump.
+ * The octant is found without trigonometry. An axis counts when it is at least tan(22.5 degrees), about 53/128, of the other axis.
+ * \return It returns the scan code of the direction, the same codes as the regular mode, or NO_KEYs inside the deadzone.
+ */
+byte phi_joysticks::sense_proportional()
+{
+  long n[2];
+  byte dir[2];
+  for (byte j=0;j<rows;j++)
+  {
+    long d=axis_vals[j]-centers[j];
+    long span0=values[j*columns]-centers[j];      // Toward the first value, scan index 0
+    long span2=values[j*columns+2]-centers[j];    // Toward the last value, scan index 2
+    if ((d<0)==(span0<0)) n[j]=span0?-d*127/span0:0;
+    else n[j]=span2?d*127/span2:0;
+    if (n[j]>127) n[j]=127;
+    if (n[j]<-127) n[j]=-127;
+  }
+  unsigned int mag=isqrt((unsigned long)(n[0]*n[0]+n[1]*n[1]));
+  if (mag<=deadzone)
+  {
+    norm_vals[0]=0;
+    norm_vals[1]=0;
+    deflection=0;
+    return NO_KEYs;
+  }
+  long scaled=(long)(mag-deadzone)*127/(127-deadzone); // Length past the deadzone, stretched back to 0-127.
+  if (scaled>127) scaled=127;
+  deflection=scaled;
+  for (byte j=0;j<rows;j++) norm_vals[j]=n[j]*scaled/mag;
+  long a0=abs(n[0]);
+  long a1=abs(n[1]);
+  dir[0]=(a0*128>a1*53)?((n[0]<0)?0:2):1;
+  dir[1]=(a1*128>a0*53)?((n[1]<0)?0:2):1;
+  return dir[0]*columns+dir[1];
+}
+
+/**
+ * \details In proportional mode, a held direction repeats faster the further the stick is pushed, going from the repeat time at the edge of the deadzone to the dash time at full deflection.
+ * \return It returns the time between repeats in clock ticks.
+ */
+unsigned long phi_joysticks::repeat_interval()
+{
+  if ((!proportional)||(buttons_dash_ticks>=buttons_repeat_ticks)) return buttons_repeat_ticks;
+  return buttons_repeat_ticks-(buttons_repeat_ticks-buttons_dash_ticks)*deflection/127;
+}
+
+#endif
+
+#if phi_enable_analog_keypads
 //Analog keys class member functions
 /*
      ___      .__   __.      ___       __        ______     _______ 
@@ -641,7 +2290,7 @@ phi_analog_keypads::phi_analog_keypads(char *na, byte *sp, int * dp, byte r, byt
   columns=c;
   button_sensed=NO_KEYs; // This indicates which button is sensed or 255 if no button is sensed.
   button_status=buttons_up; // This indicates the status of the button if button_sensed is not 255.
-  button_status_t=millis(); // This is the time stamp of the sensed button first in the status stored in button_status.
+  button_status_t=clock_now(); // This is the time stamp of the sensed button first in the status stored in button_status.
   
   for (int j=0;j<rows;j++) // Setting sensing rows to input and disabling internal pull-up resistors.
   {
@@ -661,11 +2310,10 @@ byte phi_analog_keypads::sense_all()
 
   for (byte j=0;j<rows;j++)
   {
-    int temp=analogRead(mySensorPins[j]);
+    int temp=phi_analog_read(mySensorPins[j]);
     for (byte i=0;i<columns;i++)
     {
-      int diff=abs(values[i]-temp); // Find the difference between analog read and stored values.
-      if (diff<analog_difference) 
+      if (cal_match(i+j*columns,temp,values[i],analog_difference)) // Compare analog read with stored or calibrated values.
       {
         return (i+j*columns); // returns the button pressed
       }
@@ -674,6 +2322,78 @@ byte phi_analog_keypads::sense_all()
   return NO_KEYs;
 }
 
+/**
+ * \details This senses all analog input pins and returns the keys that are down as a bit mask. Each analog pin can only report one key at a time, so chords need keys on different pins.
+ * This function is not intended to be call by arduino code but called within the library instead.
+ * \return It returns the bit mask of keys that are down, bit n for scan code n, or 0 if no key is down.
+ */
+unsigned long phi_analog_keypads::sense_mask()
+{
+  unsigned long mask=0;
+  for (byte j=0;j<rows;j++) mask|=sense_unit(j);
+  return mask;
+}
+
+/**
+ * \details This reads one analog pin and returns the key down on it as a bit mask. This is one unit of a time-sliced scan.
+ * \param u This is the analog pin index, 0 to rows-1.
+ * \return It returns the bit mask with the key on this pin, or 0 if none is down.
+ */
+unsigned long phi_analog_keypads::sense_unit(byte u)
+{
+  int temp=phi_analog_read(mySensorPins[u]);
+  for (byte i=0;i<columns;i++)
+  {
+    if (cal_match(i+u*columns,temp,values[i],analog_difference))
+    {
+      if (i+u*columns<32) return 1UL<<(i+u*columns);
+      break;
+    }
+  }
+  return 0;
+}
+
+#if phi_enable_background_scan
+/**
+ * \details A pin that isn't scheduled is read with a conversion of its own, about 112us that can't be waited for in an interrupt.
+ * \return It returns 1 if an analog pin is not scheduled with phi_adc_schedulers.
+ */
+byte phi_analog_keypads::sense_blocks()
+{
+  for (byte i=0;i<rows;i++) if (!phi_adc_schedulers::has_pin(mySensorPins[i])) return 1;
+  return 0;
+}
+#endif
+
+#if phi_enable_calibration
+/**
+ * \details This converts the analog pin a key is on, for calibration. It is always a fresh conversion, even on a scheduled pin, so calibrate_key sees the real spread and not one filtered sample over and over.
+ * \param scan This is the scan code of the key.
+ * \return It returns the reading or -1 if there is no such key.
+ */
+int phi_analog_keypads::read_key_raw(byte scan)
+{
+  if (scan>=rows*columns) return -1;
+  return phi_adc_schedulers::read_blocking(mySensorPins[scan/columns]);
+}
+
+/**
+ * \details This returns the uncalibrated value of a key from the values given to the constructor.
+ * \param scan This is the scan code of the key.
+ * \param tolerance This receives analog_difference-1, the same match the keypad uses without calibration.
+ * \return It returns the expected reading or -1 if there is no such key.
+ */
+int phi_analog_keypads::key_value(byte scan, byte *tolerance)
+{
+  *tolerance=analog_difference-1;
+  if (scan>=rows*columns) return -1;
+  return values[scan%columns];
+}
+#endif
+
+#endif
+
+#if phi_enable_matrix_keypads
 //Matrix keypads class member functions
 /*
 .___  ___.      ___   .___________..______       __  ___   ___ 
@@ -701,9 +2421,11 @@ phi_matrix_keypads::phi_matrix_keypads(char *na, byte * sp, byte r, byte c) // M
   mySensorPins=sp; // Row pins are followed by column pins
   rows=r;
   columns=c;
+  ghost_filter=1;
+  ghost_last=0;
   button_sensed=NO_KEYs; // This indicates which button is sensed or 255 if no button is sensed.
   button_status=buttons_up; // This indicates the status of the button if button_sensed is not 255.
-  button_status_t=millis(); // This is the time stamp of the sensed button first in the status stored in button_status.
+  button_status_t=clock_now(); // This is the time stamp of the sensed button first in the status stored in button_status.
   
   for (int j=0;j<rows;j++) // Setting sensing rows to input and enabling internal pull-up resistors.
   {
@@ -726,6 +2448,7 @@ phi_matrix_keypads::phi_matrix_keypads(char *na, byte * sp, byte r, byte c) // M
  */
 byte phi_matrix_keypads::sense_all()
 {
+  if (rows*columns<=32) return lowest_key(sense_mask()); // One full scan, ghost keys filtered out.
 
   for (byte j=0;j<rows;j++)
   {
@@ -743,6 +2466,81 @@ byte phi_matrix_keypads::sense_all()
   return NO_KEYs; // no buttons pressed
 }
 
+/**
+ * \details This senses every key of the matrix and returns the keys that are down as a bit mask. Each column is pulled LOW once and all rows are read while it is LOW.
+ * With the ghost filter on, the rows seen on each column are compared with every other column. Two columns that share two or more rows form a rectangle, and a ghost can be any new corner of it, so those keys are dropped. See end_frame.
+ * The filter uses the same scan, so no column is driven twice.
+ * This function is not intended to be call by arduino code but called within the library instead.
+ * \return It returns the bit mask of keys that are down, bit n for scan code n, or 0 if no key is down.
+ */
+unsigned long phi_matrix_keypads::sense_mask()
+{
+  unsigned long mask=0;
+  for (byte i=0;i<columns;i++) mask|=sense_unit(i);
+  return end_frame(mask);
+}
+
+/**
+ * \details This pulls one column LOW, reads all rows and returns the keys down on that column as a bit mask. This is one unit of a time-sliced scan.
+ * \param u This is the column, 0 to columns-1.
+ * \return It returns the bit mask of keys down on this column.
+ */
+unsigned long phi_matrix_keypads::sense_unit(byte u)
+{
+  unsigned long mask=0;
+  digitalWrite(mySensorPins[rows+u],LOW);
+  for (byte j=0;j<rows;j++)
+  {
+    if ((digitalRead(mySensorPins[j])==LOW)&&(u+j*columns<32)) mask|=1UL<<(u+j*columns);
+  }
+  digitalWrite(mySensorPins[rows+u],HIGH);
+  return mask;
+}
+
+/**
+ * \details This runs the ghost filter on a complete frame, from sense_mask or a time-sliced scan. The rows seen on each column are taken back out of the mask.
+ * A corner of a rectangle that was already down in the last filtered frame was down before the rectangle formed, so it is real and stays. Only the corners that just appeared are dropped, so a held key doesn't see a release when a ghost forms around it.
+ * \param mask This is the bit mask of keys down in the frame.
+ * \return It returns the mask without the new keys in ghost rectangles.
+ */
+unsigned long phi_matrix_keypads::end_frame(unsigned long mask)
+{
+  byte col_rows[8];         // Rows seen LOW for each column
+  unsigned long ghosts=0;   // Keys in rectangles
+  if (!ghost_filter||(rows>8)||(columns>8)||!mask)
+  {
+    ghost_last=mask;
+    return mask;
+  }
+  for (byte i=0;i<columns;i++)
+  {
+    col_rows[i]=0;
+    for (byte j=0;j<rows;j++) if ((i+j*columns<32)&&(mask&(1UL<<(i+j*columns)))) col_rows[i]|=1<<j;
+  }
+
+  for (byte i=0;i<columns;i++)
+  {
+    if (!(col_rows[i]&(col_rows[i]-1))) continue; // Fewer than two rows on this column, can't be part of a rectangle.
+    for (byte k=i+1;k<columns;k++)
+    {
+      byte common=col_rows[i]&col_rows[k];
+      if (!(common&(common-1))) continue; // Fewer than two shared rows, no rectangle.
+      for (byte j=0;j<rows;j++)
+      {
+        if (!(common&(1<<j))) continue;
+        ghosts|=1UL<<(i+j*columns);
+        ghosts|=1UL<<(k+j*columns);
+      }
+    }
+  }
+  mask&=~(ghosts&~ghost_last);
+  ghost_last=mask;
+  return mask;
+}
+
+#endif
+
+#if phi_enable_button_groups
 //Button arrays class member functions
 /*
 .______    __    __  .___________.___________.  ______   .__   __. 
@@ -776,7 +2574,7 @@ phi_button_groups::phi_button_groups(char *na, byte * sp, byte r) // button_grou
   rows=r;
   button_sensed=NO_KEYs; // This indicates which button is sensed or 255 if no button is sensed.
   button_status=buttons_up; // This indicates the status of the button if button_sensed is not 255.
-  button_status_t=millis(); // This is the time stamp of the sensed button first in the status stored in button_status.
+  button_status_t=clock_now(); // This is the time stamp of the sensed button first in the status stored in button_status.
   
   for (int j=0;j<rows;j++) // Setting sensing rows to input and enabling internal pull-up resistors.
   {
@@ -786,22 +2584,109 @@ phi_button_groups::phi_button_groups(char *na, byte * sp, byte r) // button_grou
 }
 
 /**
- * \details This is the most physical layer of the phi_keypads. Senses all input pins for a valid status. The scanKeypad calls this function and interprets the return into status of the key.
- * This function is not intended to be call by arduino code but called within the library instead.
- * If all you want is a key press, call getKey.
- * \return It returns the button scan code (0-max_button-1) that is pressed down or NO_KEYs if no button is pressed down. The return is 0-based so the value is 0-15 if the array has 16 buttons.
+ * \details This is the most physical layer of the phi_keypads. Senses all input pins for a valid status. The scanKeypad calls this function and interprets the return into status of the key.
+ * This function is not intended to be call by arduino code but called within the library instead.
+ * If all you want is a key press, call getKey.
+ * \return It returns the button scan code (0-max_button-1) that is pressed down or NO_KEYs if no button is pressed down. The return is 0-based so the value is 0-15 if the array has 16 buttons.
+ */
+byte phi_button_groups::sense_all()
+{
+  for (byte j=0;j<rows;j++)
+  {
+    buttonBits=digitalRead(mySensorPins[j]); // Sensing button, using buttonBits as a temp variable.
+    if (buttonBits==LOW)
+    {
+      return (j); // returns the button pressed
+    }
+  }
+  return NO_KEYs; // no buttons pressed
+}
+
+/**
+ * \details This senses all buttons in the group and returns the buttons that are down as a bit mask.
+ * This function is not intended to be call by arduino code but called within the library instead.
+ * \return It returns the bit mask of buttons that are down, bit n for scan code n, or 0 if no button is down.
+ */
+unsigned long phi_button_groups::sense_mask()
+{
+  unsigned long mask=0;
+  for (byte j=0;j<rows;j++)
+  {
+    if ((digitalRead(mySensorPins[j])==LOW)&&(j<32)) mask|=1UL<<j;
+  }
+  return mask;
+}
+
+#endif
+
+#if phi_enable_liudr_keypads
+//LED dimmer member functions
+/*
+ _______   __  .___  ___.
+|       \ |  | |   \/   |
+|  .--.  ||  | |  \  /  |
+|  |  |  ||  | |  |\/|  |
+|  '--'  ||  | |  |  |  |
+|_______/ |__| |__|  |__|
+*/
+/**
+ * \details Clears all LED levels and turns dimming off. The keypad constructors call this.
+ */
+void phi_led_dimmers::init_dimmer()
+{
+  for (byte b=0;b<led_bam_bits;b++) led_planes[b]=0;
+  bam_step=0;
+  led_dimming=0;
+}
+
+/**
+ * \details Sets the brightness of one LED. It shows from the next scan on.
+ * \param led This is the LED number, 0-7.
+ * \param level This is the brightness, 0 for off to led_level_max for always on. Larger values are taken as led_level_max.
+ */
+void phi_led_dimmers::set_led_level(byte led, byte level)
+{
+  if (led>7) return;
+  if (level>led_level_max) level=led_level_max;
+  for (byte b=0;b<led_bam_bits;b++)
+  {
+    bitWrite(led_planes[b],led,(level>>b)&1);
+  }
+}
+
+/**
+ * \details Returns the brightness of one LED.
+ * \param led This is the LED number, 0-7.
+ * \return It returns the level between 0 and led_level_max.
+ */
+byte phi_led_dimmers::get_led_level(byte led)
+{
+  byte level=0;
+  if (led>7) return 0;
+  for (byte b=0;b<led_bam_bits;b++) level|=bitRead(led_planes[b],led)<<b;
+  return level;
+}
+
+/**
+ * \details Sets every LED to fully on or off, for setLed and setLedByte while dimming.
+ * \param on_bits This is the status of all LEDs, LED n at bit n.
  */
-byte phi_button_groups::sense_all()
+void phi_led_dimmers::set_led_planes(byte on_bits)
 {
-  for (byte j=0;j<rows;j++)
-  {
-    buttonBits=digitalRead(mySensorPins[j]); // Sensing button, using buttonBits as a temp variable.
-    if (buttonBits==LOW)
-    {
-      return (j); // returns the button pressed
-    }
-  }
-  return NO_KEYs; // no buttons pressed
+  for (byte b=0;b<led_bam_bits;b++) led_planes[b]=on_bits;
+}
+
+/**
+ * \details Steps the modulation one scan. Plane b is shown for 2 to the power of b scans in a row, so the plane is the highest bit of bam_step+1.
+ * \return It returns the LED byte to show, LED n at bit n.
+ */
+byte phi_led_dimmers::bam_next()
+{
+  bam_step++;
+  if (bam_step>=led_level_max) bam_step=0;
+  byte plane=0;
+  for (byte s=(bam_step+1)>>1;s;s>>=1) plane++;
+  return led_planes[plane];
 }
 
 //Liudr shift register keypads class member functions
@@ -829,6 +2714,9 @@ phi_liudr_keypads::phi_liudr_keypads(char *na, byte * sp, byte cp, byte dp, byte
 {
   device_type=Liudr_shift_register_pad;
   ledStatusBits=0;
+  led_deferred=0;
+  led_dirty=0;
+  init_dimmer();
   buttonBits=255;
   key_names=na; // Translated names of the keys, such as '0'.
   mySensorPins=sp; // Row pins
@@ -839,7 +2727,7 @@ phi_liudr_keypads::phi_liudr_keypads(char *na, byte * sp, byte cp, byte dp, byte
   columns=c;
   button_sensed=NO_KEYs; // This indicates which button is sensed or 255 if no button is sensed.
   button_status=buttons_up; // This indicates the status of the button if button_sensed is not 255.
-  button_status_t=millis(); // This is the time stamp of the sensed button first in the status stored in button_status.
+  button_status_t=clock_now(); // This is the time stamp of the sensed button first in the status stored in button_status.
   
   for (int j=0;j<rows;j++) // Setting sensing rows to input and enabling internal pull-up resistors.
   {
@@ -860,28 +2748,100 @@ void phi_liudr_keypads::updateShiftRegister(byte first8, byte next8)
   shiftOut(dataPin, clockPin, MSBFIRST, first8);//MSBFIRST when flat LSBFIRST when standing.
   shiftOut(dataPin, clockPin, LSBFIRST, next8);//MSBFIRST when flat LSBFIRST when standing.
   digitalWrite(latchPin, HIGH);  // Enable update to the output buffers.
+  if (first8==ledStatusBits) led_dirty=0; // Every scan shift carries the LED byte, so pending LED changes went out with it.
 }
 
 /**
  * \details You may connect a second shift register and connect up to 8 LEDs to this register. This function can set the status of each of these 8 LEDs.
+ * In deferred mode nothing is shifted out here. The change goes out with the next scan shift or flush_leds().
  * \param led This is the LED number to be set. 0-7.
  * \param on_off This is the status you want to set the LED to, either LOW or HIGH.
  */
 void phi_liudr_keypads::setLed(byte led, byte on_off)
 {
-  bitWrite(ledStatusBits,led,on_off);
-  updateShiftRegister(ledStatusBits,buttonBits);
+  if (led_dimming)
+  {
+    set_led_level(led,on_off?led_level_max:0);
+    return;
+  }
+  byte bits=ledStatusBits;
+  bitWrite(bits,led,on_off);
+  setLedByte(bits);
 }
 
 
 /**
  * \details You may connect a second shift register and connect up to 8 LEDs to this register. This function can set the status of each of these 8 LEDs.
+ * In deferred mode nothing is shifted out here. The change goes out with the next scan shift or flush_leds().
  * \param led This is the binary status of all 8 LEDs. If you decide to turn on all LEDs, use 255.
  */
 void phi_liudr_keypads::setLedByte(byte led)
 {
+  if (led_dimming)
+  {
+    set_led_planes(led);
+    return;
+  }
+  if (led!=ledStatusBits) led_dirty=1;
   ledStatusBits=led;
+  if (!led_deferred) updateShiftRegister(ledStatusBits,buttonBits);
+}
+
+/**
+ * \details Turns deferred LED updates on or off. Use deferred updates when you set several LEDs at a time, such as a status display, so the keypad scan isn't held up by a transfer for each LED.
+ * If you call getKey in your loop, you don't need to call flush_leds since the next scan carries the LEDs. Call flush_leds when LEDs need to change while the keypad is not scanned.
+ * \param on This is 1 to defer LED updates or 0 to shift them out right away as before.
+ */
+void phi_liudr_keypads::set_led_deferred(byte on)
+{
+  led_deferred=on;
+  if (!on) flush_leds();
+}
+
+/**
+ * \details Shifts out the LED byte if it changed since it last went out. The column byte stays as the last scan left it.
+ * \return It returns 1 if the LEDs were shifted out or 0 if nothing was pending.
+ */
+byte phi_liudr_keypads::flush_leds()
+{
+  if (!led_dirty) return 0;
   updateShiftRegister(ledStatusBits,buttonBits);
+  return 1;
+}
+
+/**
+ * \details Turns LED brightness levels on or off. While on, setLed and setLedByte set LEDs fully on or off and set_led_level sets any level in between. Each getKey shows the next brightness plane with its scan shifts, so dimming takes no extra shifts but needs getKey called at a steady rate.
+ * Turning dimming off shows the LEDs that have a level above 0 as on.
+ * \param on This is 1 to dim LEDs or 0 for plain on/off LEDs.
+ */
+void phi_liudr_keypads::set_led_dimming(byte on)
+{
+  if (led_dimming&&!on)
+  {
+    byte bits=0;
+    for (byte b=0;b<led_bam_bits;b++) bits|=led_planes[b];
+    led_dimming=0;
+    setLedByte(bits);
+    return;
+  }
+  if (on&&!led_dimming)
+  {
+    set_led_planes(ledStatusBits); // Carry on/off LEDs over as full brightness.
+    bam_step=0;
+  }
+  led_dimming=on;
+}
+
+/**
+ * \details Puts the next brightness plane in ledStatusBits before this scan senses anything. The column shifts of the scan carry it out.
+ */
+byte phi_liudr_keypads::start_scan()
+{
+  if (!led_dimming) return 1;
+  byte bits=bam_next();
+  if (bits!=ledStatusBits) led_dirty=1;
+  ledStatusBits=bits;
+  return 1;
 }
 
 /**
@@ -892,24 +2852,48 @@ void phi_liudr_keypads::setLedByte(byte led)
  */
 byte phi_liudr_keypads::sense_all()
 {
-
-  for (byte j=0;j<rows;j++)
+  byte found=NO_KEYs;
+  for (byte i=0;i<columns;i++) // One shift per column reads all rows, instead of one shift per key.
   {
-    for (byte i=0;i<columns;i++)
+    buttonBits=255;
+    bitClear(buttonBits,i);
+    updateShiftRegister(ledStatusBits,buttonBits);
+    for (byte j=0;j<rows;j++)
     {
-        buttonBits=255;
-        bitClear(buttonBits,i);
-        updateShiftRegister(ledStatusBits,buttonBits);
+      if ((digitalRead(mySensorPins[j])==LOW)&&(i+j*columns<found)) found=i+j*columns; // Keep the lowest scan code, the key the row by row scan found first.
+    }
+  }
+  return found; // NO_KEYs if no buttons pressed
+}
 
-      buttonBits=digitalRead(mySensorPins[j]); // Sensing button, using buttonBits as a temp variable.
+/**
+ * \details This senses every key of the pad and returns the keys that are down as a bit mask. Each column is shifted out LOW once and all rows are read while it is LOW.
+ * This function is not intended to be call by arduino code but called within the library instead.
+ * \return It returns the bit mask of keys that are down, bit n for scan code n, or 0 if no key is down.
+ */
+unsigned long phi_liudr_keypads::sense_mask()
+{
+  unsigned long mask=0;
+  for (byte i=0;i<columns;i++) mask|=sense_unit(i);
+  return mask;
+}
 
-      if (buttonBits==LOW)
-      {
-        return (i+j*columns); // returns the button pressed
-      }
-    }
+/**
+ * \details This shifts out one column LOW, reads all rows and returns the keys down on that column as a bit mask. This is one unit of a time-sliced scan.
+ * \param u This is the column, 0 to columns-1.
+ * \return It returns the bit mask of keys down on this column.
+ */
+unsigned long phi_liudr_keypads::sense_unit(byte u)
+{
+  unsigned long mask=0;
+  buttonBits=255;
+  bitClear(buttonBits,u);
+  updateShiftRegister(ledStatusBits,buttonBits);
+  for (byte j=0;j<rows;j++)
+  {
+    if ((digitalRead(mySensorPins[j])==LOW)&&(u+j*columns<32)) mask|=1UL<<(u+j*columns);
   }
-  return NO_KEYs; // no buttons pressed
+  return mask;
 }
 
 //Liudr analog digital keypads class member functions
@@ -929,6 +2913,7 @@ byte phi_liudr_keypads::sense_all()
  * \param r This is the number of analog pins or "rows" of the analog keypad.
  * \param c This is the number of buttons attached to each analog pin or "columns" of the analog keypad. All analog pins should connect to identical button/resistor configurations.
  *  If you don't need that many buttons for one particular pin, don't forget to connect all the resistors so that the analog values will be the same.
+ *  The pin cache keeps the column pins and the 4 LED pins in 32 bits, so at most 28 columns are used.
  */
 phi_liudr_keypads_2::phi_liudr_keypads_2(char *na, byte * sp, byte asp, byte r, byte c, int * dp)
 {
@@ -938,18 +2923,74 @@ phi_liudr_keypads_2::phi_liudr_keypads_2(char *na, byte * sp, byte asp, byte r,
   analog_sensing_pin=asp;	// Analog sensing pin
   values=dp; // Points to divider value array.
   rows=r;
-  columns=c;
+  columns=(c>28)?28:c; // One bit per pin in the pin cache.
   button_sensed=NO_KEYs; // This indicates which button is sensed or 255 if no button is sensed.
   button_status=buttons_up; // This indicates the status of the button if button_sensed is not 255.
-  button_status_t=millis(); // This is the time stamp of the sensed button first in the status stored in button_status.
+  button_status_t=clock_now(); // This is the time stamp of the sensed button first in the status stored in button_status.
   
   for (int j=0;j<columns+4;j++) // Setting sensing rows and 4 LED pins to input and disabling internal pull-up resistors.
   {
     pinMode(mySensorPins[j],INPUT);
     digitalWrite(mySensorPins[j],LOW); // To use phi-3 shield with internal pullup, do digitalWrite(A0,HIGH) after simple_setup_phi_3() or after this constructor.
   }
+  pin_dir=0; // The pin cache starts out matching what was just written.
+  pin_level=0;
   pinMode(analog_sensing_pin,INPUT);
   digitalWrite(analog_sensing_pin,HIGH);	// Enable internal pullup
+  init_dimmer();
+  led_bits=0;
+  led_out=0;
+  scan_period=0;
+  last_scan_t=clock_now();
+}
+
+/**
+ * \details Sets the mode and level of one of mySensorPins through the pin cache. pinMode and digitalWrite are only called for what differs from the last write, so scans and LED updates only touch pins that really change.
+ * \param n This is the index into mySensorPins, columns first then the 4 LED pins.
+ * \param mode This is INPUT or OUTPUT.
+ * \param level This is LOW or HIGH. On an INPUT, HIGH enables the pull-up.
+ */
+void phi_liudr_keypads_2::set_pin(byte n, byte mode, byte level)
+{
+	unsigned long bit=1UL<<n;
+	if (((pin_dir&bit)!=0)!=(mode==OUTPUT))
+	{
+		pinMode(mySensorPins[n],mode);
+		pin_dir^=bit;
+	}
+	if (((pin_level&bit)!=0)!=(level!=LOW))
+	{
+		digitalWrite(mySensorPins[n],level);
+		pin_level^=bit;
+	}
+}
+
+/**
+ * \details Drives one column LOW and floats all other columns. With the pin cache this is two pin changes per column instead of two writes per column pin.
+ * \param u This is the column, 0 to columns-1.
+ */
+void phi_liudr_keypads_2::drive_column(byte u)
+{
+	for (byte j=0;j<columns;j++) set_pin(j,(j==u)?OUTPUT:INPUT,LOW);
+}
+
+/**
+ * \details Floats some of mySensorPins, as input without pull-up.
+ * \param first This is the first index into mySensorPins.
+ * \param n This is how many pins.
+ */
+void phi_liudr_keypads_2::release_pins(byte first, byte n)
+{
+	for (byte j=first;j<first+n;j++) set_pin(j,INPUT,LOW);
+}
+
+/**
+ * \details Drives the 4 LED pins.
+ * \param bits This is the status of the LEDs, LED n at bit n.
+ */
+void phi_liudr_keypads_2::show_leds(byte bits)
+{
+	for (byte i=0;i<4;i++) set_pin(columns+i,OUTPUT,bitRead(bits,i));
 }
 
 /**
@@ -960,32 +3001,93 @@ phi_liudr_keypads_2::phi_liudr_keypads_2(char *na, byte * sp, byte asp, byte r,
  */
 byte phi_liudr_keypads_2::sense_all()
 {
-int temp, diff;
+int temp;
 
 	for (byte k=0;k<columns;k++)
 	{
-		for (byte j=0;j<columns;j++) // Set all digital sense pins to tri-state
-		{
-			pinMode(mySensorPins[j],INPUT);
-			digitalWrite(mySensorPins[j],LOW);
-		}
-		pinMode(mySensorPins[k],OUTPUT); // Only set the pin being scanned to output LOW
-		digitalWrite(mySensorPins[k],LOW);
+		drive_column(k); // Only the pin being scanned is output LOW, the rest are tri-state.
 		
-		temp=analogRead(analog_sensing_pin);
+		temp=phi_adc_schedulers::read_blocking(analog_sensing_pin); // Always a fresh conversion since the voltage depends on the column just driven.
 		for (byte i=0;i<rows;i++)
 		{
-			diff=abs(values[i]-temp); // Find the difference between analog read and stored values.
-			if (diff<analog_difference_2) 
+			if (cal_match(i+k*rows,temp,values[i],analog_difference_2)) // Compare analog read with stored or calibrated values.
 			{
 				return (i+k*rows); // returns the button pressed
 			}
 		}
-		if (abs(1023-temp)<analog_difference_2) return rows*columns; // The 5V button is pressed.
+		if (cal_match(rows*columns,temp,1023,analog_difference_2)) return rows*columns; // The 5V button is pressed.
 	}
 	return NO_KEYs;
 }
 
+/**
+ * \details This scans all digital column pins and returns the keys that are down as a bit mask. Each column can only report one key at a time, so chords need keys on different columns. The 5V button is bit rows*columns.
+ * This function is not intended to be call by arduino code but called within the library instead.
+ * \return It returns the bit mask of keys that are down, bit n for scan code n, or 0 if no key is down.
+ */
+unsigned long phi_liudr_keypads_2::sense_mask()
+{
+	unsigned long mask=0;
+	for (byte k=0;k<columns;k++) mask|=sense_unit(k);
+	return mask;
+}
+
+/**
+ * \details This drives one column LOW, converts the analog pin and returns the key down on that column as a bit mask. This is one unit of a time-sliced scan. The 5V button is bit rows*columns.
+ * \param u This is the column, 0 to columns-1.
+ * \return It returns the bit mask with the key on this column, or 0 if none is down.
+ */
+unsigned long phi_liudr_keypads_2::sense_unit(byte u)
+{
+	unsigned long mask=0;
+	int temp;
+
+	drive_column(u); // Only the pin being scanned is output LOW, the rest are tri-state.
+
+	temp=phi_adc_schedulers::read_blocking(analog_sensing_pin); // Always a fresh conversion since the voltage depends on the column just driven.
+	for (byte i=0;i<rows;i++)
+	{
+		if (cal_match(i+u*rows,temp,values[i],analog_difference_2)&&(i+u*rows<32))
+		{
+			mask|=1UL<<(i+u*rows);
+			break;
+		}
+	}
+	if (cal_match(rows*columns,temp,1023,analog_difference_2)&&(rows*columns<32)) mask|=1UL<<(rows*columns);
+	return mask;
+}
+
+#if phi_enable_calibration
+/**
+ * \details This drives the column of a key and converts the analog pin, for calibration. The 5V button is read on column 0.
+ * \param scan This is the scan code of the key.
+ * \return It returns the reading or -1 if there is no such key.
+ */
+int phi_liudr_keypads_2::read_key_raw(byte scan)
+{
+	if (scan>rows*columns) return -1;
+	if (scan_period) release_pins(columns,4); // Same conditions as a scan phase.
+	drive_column(key_channel(scan));
+	int val=phi_adc_schedulers::read_blocking(analog_sensing_pin);
+	end_scan();
+	return val;
+}
+
+/**
+ * \details This returns the uncalibrated value of a key from the values given to the constructor. The 5V button is 1023.
+ * \param scan This is the scan code of the key.
+ * \param tolerance This receives analog_difference_2-1, the same match the keypad uses without calibration.
+ * \return It returns the expected reading or -1 if there is no such key.
+ */
+int phi_liudr_keypads_2::key_value(byte scan, byte *tolerance)
+{
+	*tolerance=analog_difference_2-1;
+	if (scan==rows*columns) return 1023;
+	if (scan>rows*columns) return -1;
+	return values[scan%rows];
+}
+#endif
+
 /**
  * \details You may connect a second shift register and connect up to 8 LEDs to this register. This function can set the status of each of these 8 LEDs.
  * \param led This is the LED number to be set. 0-7.
@@ -993,8 +3095,14 @@ int temp, diff;
  */
 void phi_liudr_keypads_2::setLed(byte led, byte on_off)
 {
-  pinMode(mySensorPins[columns+led],OUTPUT);
-  digitalWrite(mySensorPins[columns+led],on_off);
+  if (led>3) return;
+  bitWrite(led_bits,led,on_off);
+  if (led_dimming)
+  {
+    set_led_level(led,on_off?led_level_max:0);
+    return;
+  }
+  set_pin(columns+led,OUTPUT,on_off); // Between getKey calls the LEDs own their pins, even with scan phases.
 }
 
 
@@ -1004,10 +3112,315 @@ void phi_liudr_keypads_2::setLed(byte led, byte on_off)
  */
 void phi_liudr_keypads_2::setLedByte(byte led)
 {
-	for (byte i=0;i<4;i++)
+	led_bits=led&0x0F;
+	if (led_dimming)
+	{
+		set_led_planes(led_bits);
+		return;
+	}
+	show_leds(led_bits);
+}
+
+/**
+ * \details Turns LED brightness levels on or off for the 4 LED pins. While on, setLed and setLedByte set LEDs fully on or off and set_led_level sets any level in between.
+ * Each getKey writes only the LED pins whose level changes in the next brightness plane, so dimming needs getKey called at a steady rate. Turning dimming off shows the LEDs that have a level above 0 as on.
+ * \param on This is 1 to dim LEDs or 0 for plain on/off LEDs.
+ */
+void phi_liudr_keypads_2::set_led_dimming(byte on)
+{
+	if (led_dimming&&!on)
+	{
+		byte bits=0;
+		for (byte b=0;b<led_bam_bits;b++) bits|=led_planes[b];
+		led_dimming=0;
+		setLedByte(bits);
+		return;
+	}
+	if (on&&!led_dimming)
+	{
+		set_led_planes(led_bits); // Carry on/off LEDs over as full brightness.
+		bam_step=0;
+	}
+	led_dimming=on;
+}
+
+/**
+ * \details Splits getKey into fixed phases. Every us microseconds one scan phase runs: the LED pins float, the columns are driven and the analog pin is read. Until the next scan phase is due, getKey only drives the LEDs and returns NO_KEY, so the scan rate stays the same however fast your loop is and the LEDs are lit the rest of the time.
+ * Debounce, hold and repeat still work on the clock, but can't react faster than the scan period, so keep it well under the debounce time. Call this after set_clock.
+ * \param us This is the time from one scan phase to the next in microseconds, or 0 to scan on every getKey as before.
+ */
+void phi_liudr_keypads_2::set_scan_period(unsigned long us)
+{
+	if (!us)
+	{
+		scan_period=0;
+		return;
+	}
+	scan_period=(us*get_ticks_per_ms()+999)/1000; // At least one tick.
+	last_scan_t=clock_now()-scan_period; // First scan phase on the next getKey.
+	release_pins(0,columns);
+	show_leds(led_dimming?led_out:led_bits);
+}
+
+/**
+ * \details Steps the brightness plane, then decides what this getKey does. Without scan phases the LEDs are shown and the keypad is scanned. With scan phases, the LEDs are shown and nothing is sensed until the next scan phase is due, which then starts by floating the LED pins.
+ * \return It returns 1 if this getKey scans the keypad.
+ */
+byte phi_liudr_keypads_2::start_scan()
+{
+	led_out=led_dimming?(bam_next()&0x0F):led_bits;
+	if (!scan_period)
+	{
+		if (led_dimming) show_leds(led_out);
+		return 1;
+	}
+	if (t_now-last_scan_t<scan_period)
 	{
-		pinMode(mySensorPins[columns+i],OUTPUT);
-		digitalWrite(mySensorPins[columns+i],(led&1));
-		led=led>>1;
+		show_leds(led_out);
+		return 0;
 	}
+	last_scan_t+=scan_period; // Keep to the fixed rate,
+	if (t_now-last_scan_t>=scan_period) last_scan_t=t_now; // unless getKey wasn't called for a whole period.
+	release_pins(columns,4);
+	return 1;
+}
+
+/**
+ * \details Ends a scan phase. The columns float again and the LEDs get their pins back until the next scan phase.
+ */
+void phi_liudr_keypads_2::end_scan()
+{
+	if (!scan_period) return;
+	release_pins(0,columns);
+	show_leds(led_out);
+}
+
+#endif
+
+#if phi_enable_adc_schedulers
+//ADC scheduler class member functions
+/*
+     ___       _______       ______
+    /   \     |       \     /      |
+   /  ^  \    |  .--.  |   |  ,----'
+  /  /_\  \   |  |  |  |   |  |
+ /  _____  \  |  '--'  |   |  `----.
+/__/     \__\ |_______/     \______|
+*/
+/**
+ * \details Adds an analog pin to the round robin. The pin is read once with analogRead so its sample is valid right away, which makes this a setup() call.
+ * \param pin This is the analog pin, either as A0 or as 0, the same number you gave the device.
+ * \return It returns 1 if the pin is scheduled, or 0 if adc_channels_max pins are already scheduled.
+ */
+byte phi_adc_schedulers::add_pin(byte pin)
+{
+  if (has_pin(pin)) return 1;
+  if (pin_count>=adc_channels_max) return 0;
+  byte was_background=background;
+  pause(); // Let the running conversion finish so the new pin doesn't upset the sequence.
+  pins[pin_count]=pin;
+  samples[pin_count]=analogRead(pin);
+  last_raw[pin_count]=samples[pin_count];
+  pin_count++;
+  if (was_background) resume();
+  return 1;
+}
+
+/**
+ * \details Checks whether a pin is scheduled.
+ * \param pin This is the analog pin.
+ * \return It returns 1 if the pin is scheduled.
+ */
+byte phi_adc_schedulers::has_pin(byte pin)
+{
+  for (byte i=0;i<pin_count;i++) if (pins[i]==pin) return 1;
+  return 0;
+}
+
+/**
+ * \details Returns the latest filtered sample of a scheduled pin. This does not start a conversion or wait.
+ * \param pin This is the analog pin.
+ * \return It returns the sample between 0 and 1023, or -1 if the pin is not scheduled.
+ */
+int phi_adc_schedulers::get_sample(byte pin)
+{
+  for (byte i=0;i<pin_count;i++)
+  {
+    if (pins[i]==pin)
+    {
+#if defined(__AVR__)
+      byte sreg=SREG; // An int takes two loads on AVR, so keep the ADC interrupt from changing it in between.
+      cli();
+      int val=samples[i];
+      SREG=sreg;
+      return val;
+#else
+      return samples[i];
+#endif
+    }
+  }
+  return -1;
+}
+
+/**
+ * \details Filters a finished conversion into the sample table. A sample close to the last raw conversion is taken right away. A sample that jumped is only taken once the next conversion of the same pin agrees with it.
+ */
+void phi_adc_schedulers::store(byte i, int val)
+{
+  if (abs(val-last_raw[i])<=analog_difference)
+  {
+    samples[i]=val;
+    if (callback) callback(pins[i],val);
+  }
+  last_raw[i]=val;
 }
+
+/**
+ * \details Switches the multiplexer to pin i and starts a conversion without waiting for it. The channel numbering follows analogRead in the Arduino core.
+ */
+void phi_adc_schedulers::start(byte i)
+{
+  current=i;
+  discard=(pin_count>1)?adc_settle_conversions:0; // With one pin the multiplexer never switches, so nothing needs to settle.
+#if defined(__AVR__) && defined(ADCSRA) && defined(ADMUX)
+  byte ch=pins[i];
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  if (ch>=54) ch-=54;
+#elif defined(__AVR_ATmega32U4__)
+  if (ch>=18) ch-=18;
+  ch=analogPinToChannel(ch);
+#else
+  if (ch>=14) ch-=14;
+#endif
+#if defined(ADCSRB) && defined(MUX5)
+  ADCSRB=(ADCSRB&~(1<<MUX5))|(((ch>>3)&0x01)<<MUX5);
+#endif
+  ADMUX=(reference<<6)|(ch&0x07);
+  ADCSRA|=(1<<ADSC);
+#endif
+  running=1;
+}
+
+/**
+ * \details Handles a finished conversion of the current pin. It is thrown away while the channel settles, or stored, and then the next conversion is started. service() calls this when it sees the conversion is done. In background mode the ADC interrupt calls it.
+ * \param val This is the result of the conversion.
+ */
+void phi_adc_schedulers::conversion_done(int val)
+{
+  if (discard)
+  {
+    discard--;
+#if defined(__AVR__) && defined(ADCSRA)
+    ADCSRA|=(1<<ADSC); // Same channel, convert again now that it settled.
+#endif
+    return;
+  }
+  store(current,val);
+  start((current+1<pin_count)?current+1:0);
+}
+
+/**
+ * \details Waits for the running conversion to finish and stops the round robin there. The conversion is lost, which costs one sample of one pin.
+ */
+void phi_adc_schedulers::pause()
+{
+#if defined(__AVR__) && defined(ADCSRA)
+  ADCSRA&=~(1<<ADIE);
+  while (bit_is_set(ADCSRA, ADSC));
+#endif
+  running=0;
+  background=0;
+}
+
+/**
+ * \details Restarts background sampling after pause().
+ */
+void phi_adc_schedulers::resume()
+{
+#if adc_background_isr && defined(__AVR__) && defined(ADCSRA) && defined(ADIE)
+  if (!pin_count) return;
+  background=1;
+  ADCSRA|=(1<<ADIF); // Clear a stale completion flag so the first interrupt belongs to the conversion started next.
+  ADCSRA|=(1<<ADIE);
+  start(current);
+  discard=adc_settle_conversions; // The multiplexer may have moved while paused, even with one pin.
+#endif
+}
+
+/**
+ * \details Starts background sampling. From now on the ADC interrupt stores every conversion and starts the next one, so service() has nothing left to do and reading a scheduled pin only copies its latest sample. Call this in setup() after add_pin.
+ * This needs an AVR and adc_background_isr set to 1 in the header. Elsewhere it does nothing and the scheduler keeps working through service().
+ */
+void phi_adc_schedulers::begin()
+{
+  if (background) return;
+  resume();
+}
+
+/**
+ * \details Stops background sampling. The scheduler goes back to converting whenever service() is called.
+ */
+void phi_adc_schedulers::end()
+{
+  pause();
+}
+
+/**
+ * \details Reads an analog pin with a conversion of its own, like analogRead. The scheduler's conversion is finished and dropped first, so neither reading ends up in the other. Background sampling is resumed afterwards. Without it, the next service() starts the scheduled pin over.
+ * \param pin This is the analog pin.
+ * \return It returns the reading between 0 and 1023.
+ */
+int phi_adc_schedulers::read_blocking(byte pin)
+{
+  byte was_background=background;
+  pause();
+  int val=analogRead(pin);
+  if (was_background) resume(); // The pin after this one needs to settle again since the multiplexer moved.
+  return val;
+}
+
+/**
+ * \details This is the heart of the scheduler. If the running conversion is done, it is stored (or thrown away while the channel settles) and the next pin's conversion is started. If the conversion is still running, it returns right away.
+ * Devices reading scheduled pins call this themselves. Calling it more often from your loop gives fresher samples.
+ */
+void phi_adc_schedulers::service()
+{
+  if ((!pin_count)||background) return; // Nothing to do, or the ADC interrupt is doing it.
+#if defined(__AVR__) && defined(ADCSRA) && defined(ADMUX)
+  if (!running)
+  {
+    start(current);
+    discard=adc_settle_conversions; // The multiplexer may have moved since the last conversion, even with one pin.
+    return;
+  }
+  if (bit_is_set(ADCSRA, ADSC)) return; // Still converting
+  byte low=ADCL; // ADCL must be read first.
+  conversion_done((ADCH<<8)|low);
+#else
+  store(current,analogRead(pins[current]));
+  current=(current+1<pin_count)?current+1:0;
+#endif
+}
+
+#endif
+
+/**
+ * \details This is how the library reads analog pins. A pin scheduled with phi_adc_schedulers is served from the sample table after giving the scheduler a chance to move on, without waiting for a conversion. Any other pin is read with a conversion of its own through read_blocking.
+ * \param pin This is the analog pin.
+ * \return It returns the reading between 0 and 1023.
+ */
+int phi_analog_read(byte pin)
+{
+  phi_adc_schedulers::service(); // Returns right away when nothing is scheduled.
+  int val=phi_adc_schedulers::get_sample(pin);
+  if (val>=0) return val;
+  return phi_adc_schedulers::read_blocking(pin);
+}
+
+#if phi_enable_adc_schedulers && adc_background_isr && defined(__AVR__) && defined(ADC_vect)
+ISR(ADC_vect)
+{
+  byte low=ADCL; // ADCL must be read first.
+  phi_adc_schedulers::conversion_done((ADCH<<8)|low);
+}
+#endif
@@ -22,6 +22,29 @@
  * <a href="http://liudr.wordpress.com/phi-2-shield/">http://liudr.wordpress.com/phi-2-shield/</a>
  *
  *  \par Updates
+ * 10/18/2026: Added phi_enable_* switches for the optional phi_keypads features (chords, slicing, key handlers, layers, calibration, integrator), and listed them in extras/size_report.sh.
+ * 10/18/2026: Added key latency histograms (phi_enable_latency_histograms, dump_latency) to phi_keypads, timing each key from its first raw contact to getKey() in log2 buckets.
+ * 10/18/2026: Added integrating debounce (set_integrator) to phi_keypads, with a saturating counter per key and press/release thresholds in scans.
+ * 10/18/2026: Added background scanning of phi_keypads from a timer interrupt (set_background, scan_all, begin_timer) with a lock-free type-ahead buffer.
+ * 10/18/2026: Added phi_enable_* build switches to compile out device families, and extras/size_report.sh to list what each one costs.
+ * 10/18/2026: Added phi_device_groups, a C++11 template that polls devices of different types as one input with no virtual call per device.
+ * 10/18/2026: Added a pin cache and fixed scan/LED phases (set_scan_period) to phi_liudr_keypads_2.
+ * 10/18/2026: Added LED brightness levels (set_led_dimming, set_led_level) to both liudr keypads, modulated one plane per scan.
+ * 10/18/2026: Added deferred LED updates to phi_liudr_keypads (set_led_deferred, flush_leds). A full scan now takes one shift per column instead of one per key.
+ * 10/18/2026: Added framed key events to phi_serial_keypads (set_frame_buffers, queue_event, flush_events, read_event) with several events per frame and a CRC-8.
+ * 10/18/2026: Added EncoderType_OC support to phi_rotary_encoders_d and phi_rotary_encoders_a. Every detent of encoders resting in both 11B and 00B is reported.
+ * 10/18/2026: Added multi-turn get_position with index (Z) re-homing to all three rotary encoder classes.
+ * 10/18/2026: Added set_clock so timing can run on millis, micros or a simulated clock, sampled once per scan. Added set_debounce_us.
+ * 10/18/2026: Added per-key analog calibration with drift tracking (set_calibration, calibrate_key).
+ * 10/18/2026: Added proportional mode to phi_joysticks with deadzone, normalized axes and deflection-scaled repeat.
+ * 10/18/2026: Added keymap layers (set_layers) compiled into one table so key lookup stays one load.
+ * 10/18/2026: Added per-key handler tables (set_handlers) called on press, hold, repeat and release.
+ * 10/18/2026: Added time-sliced scanning (set_slice) so getKey has a bounded cost.
+ * 10/18/2026: Added background ADC sampling (phi_adc_schedulers::begin) and made joysticks and phi_liudr_keypads_2 share the ADC safely with it.
+ * 10/18/2026: Added phi_adc_schedulers to share the ADC among analog encoders and keypads without blocking.
+ * 10/18/2026: Added phi_rotary_encoder_banks to decode many encoders from one port snapshot.
+ * 10/18/2026: Added ghost key filter to phi_matrix_keypads.
+ * 10/18/2026: Added sense_mask multi-key scans and chords (set_chords) to phi_keypads.
  * 05/28/2015: Released under GNU GPL V 3.0 Yeah!
  * 06/25/2014: Finished coding liudr_rotary_encoders_a and liudr_rotary_encoders_d classes with tests.
  * 06/18/2014: Started to code liudr_rotary_encoders_a for the OSPL V 2.1.X
@@ -40,6 +63,68 @@
 #include <Arduino.h>
 #endif
 
+//Build configuration:
+/* Each device family can be compiled out by defining its macro as 0, which drops its code, vtables and static members from the build.
+ * The optional phi_keypads features below the families can be compiled out the same way, which also takes their state out of every keypad object.
+ * The Arduino IDE compiles the library separately from the sketch, so a #define in the sketch does not reach phi_interfaces.cpp. Either change the defaults below or pass them to every file as build flags, such as build_flags=-Dphi_enable_serial_keypads=0 on PlatformIO.
+ * Run extras/size_report.sh to see what each family and feature costs.
+ */
+#ifndef phi_enable_rotary_encoders
+#define phi_enable_rotary_encoders 1    ///< phi_rotary_encoders, phi_rotary_encoders_d and phi_rotary_encoders_a
+#endif
+#ifndef phi_enable_encoder_banks
+#define phi_enable_encoder_banks 1      ///< phi_rotary_encoder_banks
+#endif
+#ifndef phi_enable_serial_keypads
+#define phi_enable_serial_keypads 1     ///< phi_serial_keypads
+#endif
+#ifndef phi_enable_joysticks
+#define phi_enable_joysticks 1          ///< phi_joysticks
+#endif
+#ifndef phi_enable_analog_keypads
+#define phi_enable_analog_keypads 1     ///< phi_analog_keypads
+#endif
+#ifndef phi_enable_matrix_keypads
+#define phi_enable_matrix_keypads 1     ///< phi_matrix_keypads
+#endif
+#ifndef phi_enable_button_groups
+#define phi_enable_button_groups 1      ///< phi_button_groups
+#endif
+#ifndef phi_enable_liudr_keypads
+#define phi_enable_liudr_keypads 1      ///< phi_liudr_keypads and phi_liudr_keypads_2
+#endif
+#ifndef phi_enable_adc_schedulers
+#define phi_enable_adc_schedulers 1     ///< phi_adc_schedulers and its ADC interrupt. When 0, a stand-in that reads every pin with analogRead takes its place.
+#endif
+#ifndef phi_enable_device_groups
+#define phi_enable_device_groups 1      ///< phi_device_groups
+#endif
+#ifndef phi_enable_chords
+#define phi_enable_chords 1             ///< Chords on phi_keypads (set_chords)
+#endif
+#ifndef phi_enable_slicing
+#define phi_enable_slicing 1            ///< Time-sliced scanning of phi_keypads (set_slice)
+#endif
+#ifndef phi_enable_key_handlers
+#define phi_enable_key_handlers 1       ///< Key handler tables on phi_keypads (set_handlers, set_handlers_P)
+#endif
+#ifndef phi_enable_layers
+#define phi_enable_layers 1             ///< Keymap layers on phi_keypads (set_layers, layer_on)
+#endif
+#ifndef phi_enable_calibration
+#define phi_enable_calibration 1        ///< Per-key analog calibration on phi_keypads (set_calibration, calibrate_key)
+#endif
+#ifndef phi_enable_integrator
+#define phi_enable_integrator 1         ///< Integrating debounce on phi_keypads (set_integrator)
+#endif
+#ifndef phi_enable_background_scan
+#define phi_enable_background_scan 1    ///< Background scanning of phi_keypads from a timer interrupt (set_background, scan_all)
+#endif
+#ifndef phi_enable_latency_histograms
+#define phi_enable_latency_histograms 0 ///< Key latency histograms on phi_keypads (dump_latency). Off by default since they take RAM in every keypad.
+#endif
+#define phi_keypads_used (phi_enable_joysticks||phi_enable_analog_keypads||phi_enable_matrix_keypads||phi_enable_button_groups||phi_enable_liudr_keypads) ///< phi_keypads is compiled when any class built on it is.
+
 //Device types:
 #define Liudr_shift_register_pad 0      ///< Liudr shift register pad used on phi-panels.
 #define Single_button 1                 ///< (Not used in this library) Single buttons need to connect an arduino pin to GND.
@@ -61,6 +146,14 @@
 #define buttons_held 3      ///< Non-transitional button status
 #define buttons_released 4  ///< Transitional button status
 #define buttons_debounce 5  ///< One needs to wait till debounce status is over to become pressed status to confirm a press.
+#define buttons_repeated 6  ///< Not a status. This is the event a held key fires each time it repeats.
+
+//Key event masks for phi_key_handlers
+#define event_pressed (1<<buttons_pressed)    ///< Call the handler when the key is pressed.
+#define event_held (1<<buttons_held)          ///< Call the handler when the key has been down for the hold time.
+#define event_repeated (1<<buttons_repeated)  ///< Call the handler each time a held key repeats.
+#define event_released (1<<buttons_released)  ///< Call the handler when the key is released.
+#define event_all (event_pressed|event_held|event_repeated|event_released) ///< Call the handler on every event.
 
 //Operating parameters
 #define buttons_hold_time_def 1000      ///< Default key down time needed to be considered the key is held down
@@ -72,6 +165,8 @@
 //Internal and external "NO KEY" return values
 #define NO_KEYs 255         ///< This is no key in scan code, internal to the library.
 #define NO_KEY 0            ///< This is no key that the library outputs to a caller, to be compatible with keypad.h
+#define KEY_TRANSPARENT ((char)255) ///< Marks a key in a keymap layer that falls through to the layer below.
+#define layers_max 8        ///< Maximal number of keymap layers on top of the base mapping.
 
 //Analog keypad specific defines
 #define analog_difference 12			///< Analog reading maximal difference when comparing with expected analog value.
@@ -106,18 +201,33 @@ class multiple_button_input{
 /// This should be run after getKey to get the up-to-date result.
   virtual byte get_sensed()=0;
 /// This sets how long the button needs to be held before it repeats.
-  virtual void set_hold(unsigned int ht) {buttons_hold_time=ht;};
+  virtual void set_hold(unsigned int ht) {buttons_hold_time=ht; update_ticks();};
 /// This sets how long the button needs to be held before it is considered pressed.
-  virtual void set_debounce(unsigned int dt) {buttons_debounce_time=dt;};
+  virtual void set_debounce(unsigned int dt) {buttons_debounce_time=dt; buttons_debounce_ticks=(unsigned long)dt*ticks_per_ms;};
 /// This sets how long the button needs to be held before it repeats rapidly.
   virtual void set_dash_threshold(unsigned int dt) {buttons_dash_threshold=dt;};
 /// This sets how often the button press repeats after being held.
-  virtual void set_repeat(unsigned int rt) {buttons_repeat_time=rt;};
+  virtual void set_repeat(unsigned int rt) {buttons_repeat_time=rt; update_ticks();};
 /// This sets how often the button press rapidly repeats after being held.
-  virtual void set_dash(unsigned int dt) {buttons_dash_time=dt;};
+  virtual void set_dash(unsigned int dt) {buttons_dash_time=dt; update_ticks();};
+/// This sets the debounce time in microseconds. It only gets finer than 1ms with a microsecond clock, see set_clock.
+  static void set_debounce_us(unsigned long us);
+/// This sets the clock all timing runs on, such as millis (default) or micros, and how many of its ticks make 1ms.
+  static void set_clock(unsigned long (*clock)(), unsigned int tpm);
+/// This returns the time on the library's clock, in ticks.
+  static unsigned long clock_now() {return clock_fn();}
+/// This returns how many clock ticks make 1ms.
+  static unsigned int get_ticks_per_ms() {return ticks_per_ms;}
 
   protected:
-  static unsigned long t_last_action;           ///< This stores the last time any real keypad was active. You may use this to implement sleeping mode.
+  static unsigned long t_last_action;           ///< This stores the last time any real keypad was active, in clock ticks. You may use this to implement sleeping mode.
+  static unsigned long (*clock_fn)();           ///< Clock function, millis by default
+  static unsigned int ticks_per_ms;             ///< Clock ticks in 1ms, 1 for millis and 1000 for micros
+  static unsigned long buttons_debounce_ticks;  ///< Debounce time in clock ticks
+  static unsigned long buttons_hold_ticks;      ///< Hold time in clock ticks
+  static unsigned long buttons_repeat_ticks;    ///< Repeat time in clock ticks
+  static unsigned long buttons_dash_ticks;      ///< Dash repeat time in clock ticks
+  static void update_ticks();                   ///< Converts the ms times into clock ticks, done once when a time or the clock changes.
   static unsigned int buttons_hold_time;        ///< Key down time needed to be considered the key is held down
   static unsigned int buttons_debounce_time;    ///< Key down time needed to be considered the key is not bouncing anymore
   static unsigned int buttons_dash_threshold;   ///< Key down time needed to be considered the key is held down long enough to repeat in a dash speed
@@ -126,6 +236,44 @@ class multiple_button_input{
 };
 
 // Derived classes start here. Note: phi_keypads is pure.
+//Rotary encoder types, shared by all encoder classes:
+#define EncoderType_NO 0				///< This rotary encoder has both channels normally open. So if you connect common to GND and channels to arduino pins with pull up resistor enabled, normaly in a detent both channels are open (disconnected from common, which is 5V via pull up). Valid start/stop status binary is 11B
+#define EncoderType_NC 1				///< This rotary encoder has both channels normally closed. So if you connect common to GND and channels to arduino pins with pull up resistor enabled, normaly in a detent both channels are closed (connected to common, in which case is GND). Valid start/stop status binary is 00B
+#define EncoderType_OC 2				///< Supported by phi_rotary_encoders_d and phi_rotary_encoders_a. This rotary encoder has both channels normally open or close. So if you connect common to GND and channels to arduino pins with pull up resistor enabled, normaly in a detent both channels are either open (disconnected from common) or closed (connected to common, which is GND). This type of rotary encoder has twice the detent as complete pulses per 360 degrees of rotation.  Valid start/stop status binary is 11B or 00B. A detent is reported at each of them, every half cycle.
+
+#if phi_enable_rotary_encoders
+/*
+.______     ______        _______.
+|   _  \   /  __  \      /       |
+|  |_)  | |  |  |  |    |   (----`
+|   ___/  |  |  |  |     \   \    
+|  |      |  `--'  | .----)   |   
+| _|       \______/  |_______/    
+*/
+#define encoder_no_index 255    ///< Index pin value meaning the encoder has no index (Z) channel.
+
+/** \brief a multi-turn position counter shared by phi_rotary_encoders, phi_rotary_encoders_d and phi_rotary_encoders_a
+ * \details Each detent up adds one to a signed 32-bit position and each detent down subtracts one, so the position keeps counting across full turns instead of wrapping at detent like get_angle().
+ * An encoder with an index (Z) channel pulses it once per turn. Call set_index() with its pin and active level and every time the index turns active, the position snaps to the nearest whole turn.
+ * This re-homes the knob after power up and takes out any detents that were missed, without losing the turn count.
+ * A long takes four loads on AVR. If you call getKey() from an interrupt, read the position with get_position(), which keeps the interrupt from changing it halfway through the read.
+*/
+class phi_encoder_positions{
+  public:
+  long get_position();      ///< Returns a consistent snapshot of the multi-turn position.
+  void set_position(long pos); ///< Sets the multi-turn position, such as to zero it.
+  void set_index(byte pin, byte level=LOW); ///< Sets the index (Z) pin and the level it reads when active. Use encoder_no_index to disable.
+
+  protected:
+  volatile long position;   ///< Multi-turn position in detents. Positive is up.
+  byte index_pin;           ///< Arduino pin connected to the index channel or encoder_no_index
+  byte index_level;         ///< Level the index pin reads when active
+  byte index_state;         ///< Whether the index was active on the last check, to catch the moment it turns active.
+  void init_position();     ///< Clears the position and index. Called by the encoder constructors.
+  void update_position(signed char dir, byte det); ///< Moves the position by dir detents then checks the index.
+  byte position_angle(byte det); ///< Returns the position between 0 and det-1.
+};
+
 /*
 .______        ______   .___________.    ___      .______     ____    ____
 |   _  \      /  __  \  |           |   /   \     |   _  \    \   \  /   /
@@ -136,7 +284,7 @@ class multiple_button_input{
 */
 /** \brief a class for rotary encoders. Please use phi_rotary_encoders_d in new projects. This is here for backward compatibility.
  * \details  Please use phi_rotary_encoders_d in new projects. This is here for backward compatibility. This class senses a rotary encoder and reports when the rotary knob is turned one detent up or down.
- * You may use this similarly to a keypad. A call to getKey will yield say 'U' or 'D' for dial up or down. You can also call get_angle to get the orientation of the dial.
+ * You may use this similarly to a keypad. A call to getKey will yield say 'U' or 'D' for dial up or down. You can also call get_angle to get the orientation of the dial, or get_position to get the multi-turn position. See phi_encoder_positions.
  * To use a rotary encoder with a clickable shaft, define a button with phi_button_arrays class and sense it separately.
  * There are several types of rotary encoders with detents, one with both channels off when the encoder is in a detent, another with both channels on when the encoder is in a detent, and then a third type with both channels either on or both off when the encoder is in a detent. The last type has twice the detent as it has complete pulses, such as 12 pulse and 24 detents per 360 degree of rotation. By default, a rotary encoder is set up to have both channels off when the encoder is in a detent. The class does not specifically support or has been tested with rotary encoders without detents, although you are welcome to try and get back to me.
  * There are several ways to connect a rotary encoder to Arduino. The most obvious way is to connect each channel to an Arduino pin and tie the common to ground. Then you enable internal pullup resistor on the Arduino channels. Another way that I have developed is to connect a rotary encoder to one Arduino analog pin and add 3 resistors. This way saves one pin or two pins (if you use Arduino nano, A6 and A7 are analog but have no digital functions). You connect a 22K resistor between 5V and channel A, another 22K resistor between channel A and common, then a 10K resistor between common and channel B. 
@@ -145,7 +293,7 @@ class multiple_button_input{
  * Then if the return is up or down, you can trigger actions.
  * This library is not interrupt driven and thus has no call-back functions.
 */
-class phi_rotary_encoders: public multiple_button_input{
+class phi_rotary_encoders: public multiple_button_input, public phi_encoder_positions{
   public:
   phi_rotary_encoders(char *na, byte ChnA, byte ChnB, byte det); ///< Constructor for rotary encoder
   byte getKey();            ///< Returns the key corresponding to dial up or down or NO_KEY.
@@ -158,7 +306,6 @@ class phi_rotary_encoders: public multiple_button_input{
   byte EncoderChnB;         ///< Arduino pin connected to channel B of the encoder
   byte detent;              ///< Number of detents per rotation of the encoder
   byte stat_seq_ptr;        ///< Current status of the encoder in gray code
-  byte counter;             ///< Counts for get_angle() to calculate knob orientation
   char * key_names;         ///< Pointer to array of characters two elements long. Each click up or down is translated into a name from this array such as 'U'.
 };
 
@@ -172,7 +319,7 @@ ______ _____ _____ ___  ________   __    ______
 */
 /** \brief a class for rotary encoders connected to digital inputs
  * \details This class senses a rotary encoder with two digital inputs and reports when the rotary knob is turned one detent up or down.
- * You may use this similarly to a keypad. A call to getKey will yield say 'U' or 'D' for dial up or down. You can also call get_angle to get the orientation of the dial.
+ * You may use this similarly to a keypad. A call to getKey will yield say 'U' or 'D' for dial up or down. You can also call get_angle to get the orientation of the dial, or get_position to get the multi-turn position. See phi_encoder_positions.
  * To use a rotary encoder with a clickable shaft, define a button with phi_button_arrays class and sense it separately.
  * There are several types of rotary encoders with detents, one with both channels off when the encoder is in a detent, another with both channels on when the encoder is in a detent, and then a third type with both channels either on or both off when the encoder is in a detent. The last type has twice the detent as it has complete pulses, such as 12 pulse and 24 detents per 360 degree of rotation. By default, a rotary encoder is set up to have both channels off when the encoder is in a detent (EncoderType_NO). The class does not specifically support or has been tested with rotary encoders without detents, although you are welcome to try and get back to me.
  * There are several ways to connect a rotary encoder to Arduino. The most obvious way is to connect each channel to an Arduino pin and tie the common to ground. Then you enable internal pullup resistor on the Arduino channels. This class handles this type of hookup. Another way that I have developed is to connect a rotary encoder to one Arduino analog pin and add 3 resistors. Use the phi_rotary_encoders_a class for analog pin inputs. 
@@ -181,9 +328,6 @@ ______ _____ _____ ___  ________   __    ______
  * Then if the return is up or down, you can trigger actions.
  * This library is not interrupt driven and thus has no call-back functions.
 */
-#define EncoderType_NO 0				///< This rotary encoder has both channels normally open. So if you connect common to GND and channels to arduino pins with pull up resistor enabled, normaly in a detent both channels are open (disconnected from common, which is 5V via pull up). Valid start/stop status binary is 11B
-#define EncoderType_NC 1				///< This rotary encoder has both channels normally closed. So if you connect common to GND and channels to arduino pins with pull up resistor enabled, normaly in a detent both channels are closed (connected to common, in which case is GND). Valid start/stop status binary is 00B
-#define EncoderType_OC 2				///< NOT yet supported. This rotary encoder has both channels normally open or close. So if you connect common to GND and channels to arduino pins with pull up resistor enabled, normaly in a detent both channels are either open (disconnected from common) or closed (connected to common, which is GND). This type of rotary encoder has twice the detent as complete pulses per 360 degrees of rotation.  Valid start/stop status binary is 11B or 00B.
 
 /* not used
 #define EncoderStatus_Ready	0			///< This status means the encoder has an empty state storage and the current state is NOT a valid starting state. The encoder will stay in this state until a valid starting state appears.
@@ -196,7 +340,7 @@ ______ _____ _____ ___  ________   __    ______
 #define EncoderBA2	0x34				///< This is the second sequence of A changes status, then B, 110100B. It is interpreted as 'D' for EncoderType_OC.
 */
 
-class phi_rotary_encoders_d: public multiple_button_input{
+class phi_rotary_encoders_d: public multiple_button_input, public phi_encoder_positions{
 	public:
 	phi_rotary_encoders_d(char *na, byte ChnA, byte ChnB, byte det, byte en_type); ///< Constructor for rotary encoder
 	byte getKey();            ///< Returns the key corresponding to dial up or down or NO_KEY.
@@ -209,8 +353,8 @@ class phi_rotary_encoders_d: public multiple_button_input{
 	byte EncoderChnB;         ///< Arduino pin connected to channel B of the encoder
 	byte EncoderType;			///< This describes the type of rotary encoder. Please see the #define in the beginning
 	byte detent;              ///< Number of detents per rotation of the encoder
-	byte counter;             ///< Counts for get_angle() to calculate knob orientation
 	byte stat_seq_ptr;        ///< Current status of the encoder in gray code
+	byte rest_state;          ///< State the encoder last rested in, 11B, or 00B for an EncoderType_OC encoder resting between pulses.
 	char * key_names;         ///< Pointer to array of characters two elements long. Each click up or down is translated into a name from this array such as 'U'.
 	//byte valid_starting_state(byte st);				////< This function checks whether the current state in binary is a valid starting state. This solely depends on the encoder type and not how it is wired up.
 	byte get_encoder_state();	///< This function does the actual sensing of the encoder and returns a 2-bit state, with channel A at 1th bit and channel B at 0th bit.
@@ -228,7 +372,7 @@ ______ _____ _____ ___  ________   __      ___
 */
 /** \brief a class for rotary encoders connected to one analog input
  * \details This class senses a rotary encoder with one analog input and reports when the rotary knob is turned one detent up or down.
- * You may use this similarly to a keypad. A call to getKey will yield say 'U' or 'D' for dial up or down. You can also call get_angle to get the orientation of the dial.
+ * You may use this similarly to a keypad. A call to getKey will yield say 'U' or 'D' for dial up or down. You can also call get_angle to get the orientation of the dial, or get_position to get the multi-turn position. See phi_encoder_positions.
  * To use a rotary encoder with a clickable shaft, define a button with phi_button_arrays class and sense it separately.
  * There are several types of rotary encoders with detents, one with both channels off when the encoder is in a detent, another with both channels on when the encoder is in a detent, and then a third type with both channels either on or both off when the encoder is in a detent. The last type has twice the detent as it has complete pulses, such as 12 pulse and 24 detents per 360 degree of rotation. By default, a rotary encoder is set up to have both channels off when the encoder is in a detent. The class does not specifically support or has been tested with rotary encoders without detents, although you are welcome to try and get back to me.
  * There are several ways to connect a rotary encoder to Arduino. The most obvious way is to connect each channel to an Arduino pin. Use phi_rotary_encoders_d for this type of hookup. This class handles another way that I have developed is to connect a rotary encoder to one Arduino analog pin and add 3 resistors. This way saves one pin or two pins (if you use Arduino nano, A6 and A7 are analog but have no digital functions). You connect a 22K resistor between 5V and channel A, another 22K resistor between channel A and common, then a 10K resistor between common and channel B.
@@ -237,7 +381,7 @@ ______ _____ _____ ___  ________   __      ___
  * Then if the return is up or down, you can trigger actions.
  * This library is not interrupt driven and thus has no call-back functions.
 */
-class phi_rotary_encoders_a: public multiple_button_input{
+class phi_rotary_encoders_a: public multiple_button_input, public phi_encoder_positions{
 	public:
 	phi_rotary_encoders_a(char *na, byte ChnA, byte *vals, byte det, byte en_type); ///< Constructor for rotary encoder
 	byte getKey();            ///< Returns the key corresponding to dial up or down or NO_KEY.
@@ -251,12 +395,64 @@ class phi_rotary_encoders_a: public multiple_button_input{
 	
 	byte detent;              ///< Number of detents per rotation of the encoder
 	byte stat_seq_ptr;        ///< Current status of the encoder in gray code
-	byte counter;             ///< Counts for get_angle() to calculate knob orientation
+	byte rest_state;          ///< State the encoder last rested in, 11B, or 00B for an EncoderType_OC encoder resting between pulses.
 	char * key_names;			///< Pointer to array of characters two elements long. Each click up or down is translated into a name from this array such as 'U'.
 	byte * analog_values;		///< This stores the analog values of the encoder when the various encoder states: [0]=A&B open, [1]=A closed, B open, [2]=A&B closed, [3]=A open, B closed, [4]=A&B open. Being byte arrays, they only store 1/4 the actual analogRead values, since the four values are far enough apart. Example: analog_values[]={152,128,0,80};
 	byte get_encoder_state(byte prev_state);	///< This function does the actual sensing of the encoder and returns a 2-bit state, with channel A at 1th bit and channel B at 0th bit.
 };
 
+#endif
+
+#if phi_enable_encoder_banks
+/*
+______  ___   _   _  _   __
+| ___ \/ _ \ | \ | || | / /
+| |_/ / /_\ \|  \| || |/ / 
+| ___ \  _  || . ` ||    \ 
+| |_/ / | | || |\  || |\  \
+\____/\_| |_/\_| \_/\_| \_/
+*/
+#define encoder_bank_max 8				///< Maximal number of encoders in one phi_rotary_encoder_banks object.
+#define encoder_bank_ports 6			///< Maximal number of distinct AVR ports one phi_rotary_encoder_banks object reads. Channels on further ports are read with digitalRead.
+
+/** \brief a class for a bank of rotary encoders connected to digital inputs
+ * \details This class senses up to encoder_bank_max rotary encoders with two digital inputs each, the same hookup as phi_rotary_encoders_d, but in one object.
+ * Each poll reads every port involved once (on AVR, straight from the PIN registers) and then decodes all encoders from that snapshot with one shared lookup table, so adding encoders costs a few table lookups instead of another object, virtual call and two digitalReads.
+ * Call poll() to get the number of detents each encoder turned since the last poll, positive for up and negative for down. Or call getKey() like any other multiple_button_input to get one named dial up or down at a time, with two names per encoder in na.
+ * Don't mix poll() and getKey() on the same object since both consume the same pending detents.
+ * Only EncoderType_NO and EncoderType_NC are supported.
+*/
+class phi_rotary_encoder_banks: public multiple_button_input{
+	public:
+	phi_rotary_encoder_banks(char *na, byte *pins, byte n, byte det, byte en_type); ///< Constructor for a bank of rotary encoders
+	byte getKey();            ///< Returns the key corresponding to dial up or down of the first encoder that turned or NO_KEY.
+	byte get_status();        ///< Always returns buttons_up since the encoder works differently than other keypads.
+	byte get_sensed();        ///< Always returns NO_KEY since the encoder works differently than other keypads.
+	byte poll(signed char *deltas);  ///< Reads all encoders once and stores the detents each one turned since the last poll in deltas[]. Returns the number of encoders that turned.
+	byte get_angle(byte enc); ///< Get the angle or orientation of one encoder between 0 and detent-1.
+
+	protected:
+	byte encoders;            ///< Number of encoders in this bank
+	byte * EncoderPins;       ///< Pointer to array of pins, channel A then channel B of each encoder.
+	byte EncoderType;         ///< This describes the type of rotary encoders. Please see the #define in the beginning
+	byte detent;              ///< Number of detents per rotation of the encoders
+	char * key_names;         ///< Pointer to array of characters two elements per encoder. Each click up or down is translated into a name from this array such as 'U'.
+	byte states[encoder_bank_max];       ///< Last 2-bit state of each encoder, with channel A at 1th bit and channel B at 0th bit.
+	signed char steps[encoder_bank_max];        ///< Quarter steps each encoder moved since it left its detent.
+	signed char pending[encoder_bank_max];      ///< Detents each encoder turned that haven't been reported by poll or getKey.
+	byte counters[encoder_bank_max];     ///< Orientation of each encoder between 0 and detent-1 for get_angle()
+#ifdef __AVR__
+	volatile uint8_t * port_regs[encoder_bank_ports]; ///< Input registers of the ports that have channels on them
+	byte port_count;                     ///< Number of ports in port_regs
+	byte chn_port[encoder_bank_max*2];   ///< Index into port_regs for each channel or 255 if the channel is read with digitalRead
+	byte chn_mask[encoder_bank_max*2];   ///< Bit mask of each channel within its port
+#endif
+	void update();            ///< Reads all channels once and decodes every encoder into pending.
+};
+
+#endif
+
+#if phi_enable_serial_keypads
 /*
      _______. _______ .______       __       ___       __
     /       ||   ____||   _  \     |  |     /   \     |  |
@@ -275,21 +471,116 @@ class phi_rotary_encoders_a: public multiple_button_input{
  * In Arduino IDE 1.0, both software and hardware serials are supported. In Arduino IDE 0022, only hardware serial is supported since the software serial library in this and previous versions don't inherit from Stream.
  * The getKey simply reads from serial port and returns either a character or NO_KEY.
  * The serial port has to be initialized with begin method before it can be passed to this object.
+ *
+ * Optionally, key events can be sent in binary frames instead, so press, hold, repeat and release and their timing reach the other side, several events per frame. Give the object buffers with set_frame_buffers.
+ * A frame is the sync byte serial_frame_sync, the number of events, 4 bytes per event (key name, event such as buttons_pressed, and the milliseconds since the event before it, low byte first) and a CRC-8 of everything after the sync byte.
+ * On the sending side, such as a panel with a keypad, call queue_event from a key handler (see phi_keypads::set_handlers) and flush_events in loop(). Events are written into the frame in place and the frame goes out in one write.
+ * On the receiving side, getKey and read_event move whatever the port has into the receive ring and check frames where they sit in the ring. Events are read straight out of it. Bad or partial frames are skipped up to the next sync byte.
+ * In this mode getKey returns the key of each press and repeat, and get_sensed and get_status return the key and event last received.
 */
+#define serial_frame_sync 0xA5          ///< First byte of every event frame.
+#define serial_frame_events_max 16      ///< Maximal number of events in one frame.
+#define serial_event_bytes 4            ///< Bytes each event takes in a frame.
+#define serial_frame_bytes(n) (3+(n)*serial_event_bytes) ///< Bytes a frame of n events takes, with sync, count and CRC.
+
+/// One key event sent or received in a frame.
+struct phi_key_events{
+  byte key;               ///< Key name, such as '1'.
+  byte event;             ///< buttons_pressed, buttons_held, buttons_repeated or buttons_released.
+  unsigned int dt;        ///< Milliseconds since the event before it, up to 65535.
+};
+
 class phi_serial_keypads:public multiple_button_input {
   public:
   phi_serial_keypads(Stream *ser, unsigned long bau); ///< Constructor for <a href="http://liudr.wordpress.com/phi-panel/">phi-panel serial LCD keypads</a> or serial port input
   byte getKey();                    ///< Returns the key coming from serial port or NO_KEY.
-/// Get sensed button name. No serial port read will be done and it always return NO_KEY.
-  virtual byte get_sensed(){return NO_KEY;};
-/// Get status of the button being sensed. No serial port read will be done and it always return buttons_up.
-  virtual byte get_status(){return buttons_up;};
+/// Get sensed button name. No serial port read will be done. It returns the key of the last framed event, or NO_KEY.
+  virtual byte get_sensed(){return frame_key;};
+/// Get status of the button being sensed. No serial port read will be done. It returns the last framed event, or buttons_up.
+  virtual byte get_status(){return frame_status;};
+  void set_frame_buffers(byte *rx, byte rx_len, byte *tx, byte tx_len); ///< Switches to framed events with a receive ring and a transmit frame buffer. Either can be 0.
+  byte read_event(phi_key_events *ev); ///< Gets the next received event. Returns 1 if there was one.
+  byte queue_event(byte key, byte event); ///< Adds an event to the frame being built. A full frame is sent first.
+  byte flush_events();              ///< Sends the frame being built. Returns the number of events sent.
 
   protected:
   Stream *ser_port; ///< Pointer to a Stream object such as hardware serial port.
   unsigned long ser_baud; ///< Baud rate of the Stream object.
+  byte *rx_ring;          ///< Receive ring supplied by set_frame_buffers, or 0 for one key per byte.
+  byte rx_size;           ///< Size of rx_ring
+  byte rx_head;           ///< Where the next received byte goes
+  byte rx_tail;           ///< Oldest byte not consumed, the start of the frame being read
+  byte rx_next;           ///< Offset from rx_tail of the next event of a checked frame
+  byte rx_left;           ///< Events of the checked frame not read yet
+  byte *tx_frame;         ///< Transmit frame supplied by set_frame_buffers, or 0
+  byte tx_max;            ///< Events that fit in tx_frame
+  byte tx_count;          ///< Events in tx_frame
+  unsigned long tx_last;  ///< Clock ticks at the last queued event
+  byte frame_key;         ///< Key of the last framed event
+  byte frame_status;      ///< Last framed event
+  void receive();         ///< Moves available bytes from the port into the receive ring.
+  byte rx_at(byte i);     ///< Returns the byte i places after rx_tail.
+  byte check_frame();     ///< Finds and checks the next frame in the ring. Returns 1 once a good frame's events can be read.
 };
 
+#endif
+
+#if phi_keypads_used
+/*
+ __          ___   .___________.
+|  |        /   \  |           |
+|  |       /  ^  \ `---|  |----`
+|  |      /  /_\  \    |  |
+|  `----./  _____  \   |  |
+|_______/__/     \__\  |__|
+*/
+#ifndef latency_buckets
+#define latency_buckets 16          ///< Buckets in a latency histogram. Bucket b counts latencies of 2^(b-1) to 2^b-1 clock ticks, bucket 0 counts 0 and the last bucket everything longer. 16 covers 32s on millis. Use about 24 on micros.
+#endif
+
+#if phi_enable_latency_histograms
+/** \brief Key latency histogram shared by all keypads
+ * \details Turned on with phi_enable_latency_histograms. Each keypad then notes the clock when a scan first finds a contact after none, and when getKey returns the key it leads to. The time in between, bounce, debounce and how often getKey is called all included, is counted in a log2 histogram.
+ * Contacts that never become a key, such as a glitch, are dropped once nothing has been sensed for the debounce time.
+ * Print the histogram in the field with dump_latency(&Serial). Holds and repeats of a key are not counted, only the press.
+ * In background mode the key is counted when the interrupt queues it, so the wait in the type-ahead buffer is not included.
+*/
+class phi_latency_histograms{
+  public:
+  void dump_latency(Print *out);  ///< Prints the histogram in one compact line.
+  void clear_latency();           ///< Clears the histogram.
+  unsigned int get_latency_count(byte bucket); ///< Returns the count of one bucket.
+  unsigned long get_latency_max() {return latency_max;} ///< Returns the longest latency seen, in clock ticks.
+
+  protected:
+  unsigned int latency_counts[latency_buckets]; ///< Count of each bucket, stopping at 65535.
+  unsigned long latency_max;      ///< Longest latency seen, in clock ticks.
+  unsigned long latency_t0;       ///< When the contact being timed was first sensed.
+  unsigned long latency_t_raw;    ///< When a contact was last sensed.
+  byte latency_armed;             ///< 1 while a contact is being timed.
+  byte latency_raw;               ///< 1 if the last scan sensed a contact.
+  void init_latency();            ///< Clears the histogram and stops timing. Called by the keypad constructor.
+  void latency_sample(byte down, unsigned long t); ///< Notes whether a scan sensed any contact, and starts timing on the first contact after none.
+  void latency_drop(unsigned long t, unsigned long settle); ///< Stops timing a contact that has not been sensed for settle ticks.
+  void latency_emit(unsigned long t); ///< Counts the time since the contact was first sensed, if one is being timed.
+};
+#else
+/// Stand-in for phi_latency_histograms when phi_enable_latency_histograms is 0. It takes no RAM and does nothing.
+class phi_latency_histograms{
+  public:
+  void dump_latency(Print *) {}
+  void clear_latency() {}
+  unsigned int get_latency_count(byte) {return 0;}
+  unsigned long get_latency_max() {return 0;}
+
+  protected:
+  void init_latency() {}
+  void latency_sample(byte, unsigned long) {}
+  void latency_drop(unsigned long, unsigned long) {}
+  void latency_emit(unsigned long) {}
+};
+#endif
+
 /*
  __  ___  ___________    ____ .______      ___       _______
 |  |/  / |   ____\   \  /   / |   _  \    /   \     |       \
@@ -305,17 +596,203 @@ class phi_serial_keypads:public multiple_button_input {
  * The sense_all reads digital pins for input.
  * The scanKeypad turns these inputs into status changes for keys and provide scan code of the pressed key. It handles status change including debouncing and repeat.
  * The getKey translates the key press from scan code (0 to max_key-1) into named keys with the mapping array.
+ * Optionally, a table of chords (key combinations) can be registered with set_chords. Chords need a keypad that can sense several keys at once, see sense_mask.
+ * Normally the keypad is only scanned while getKey is called, so keys pressed while the loop is busy, such as writing to an SD card, are missed. With set_background, scanning moves into scan_all(), called from a timer interrupt at a fixed rate, and every key found waits in a type-ahead buffer until getKey returns it:
+
+ phi_typed_keys typed[16];
+ keypad.set_background(typed, 16);
+ phi_keypads::begin_timer(5); // scan about every 5ms
+
+ * The interrupt only writes the buffer's head and getKey only writes its tail, so neither needs to turn interrupts off. Key handlers set with set_handlers are queued by the interrupt and called from getKey, so they run in your loop as usual.
+ * Anything else that drives the keypad's pins, such as setLed on the liudr keypads, must then be done with interrupts off.
+*/
+//Chord states
+#define chord_idle 0        ///< No chord key is down.
+#define chord_pending 1     ///< A chord key is down and the chord window is open. Chord keys are held back.
+#define chord_fired 2       ///< A chord was reported. Chord keys are suppressed until they are all released.
+#define chord_passed 3      ///< The chord window expired. The key down is handled as a normal key.
+
+/** \brief One entry in a chord table
+ * \details A chord is a combination of keys pressed together, such as shift and a number key. The mask has bit n set for scan code n (0 to 31), so a chord of scan codes 0 and 5 has mask (1UL<<0)|(1UL<<5).
+ * The name is what getKey returns when the chord is pressed, such as 'S'.
+*/
+#if phi_enable_chords
+struct phi_chords{
+  unsigned long mask;     ///< Bit mask of scan codes that make up the chord.
+  char name;              ///< Key name that getKey returns when the chord is pressed.
+};
+#endif
+
+/** \brief One entry in a key handler table
+ * \details A key handler table has one entry per scan code, so the handler of a key is found with one indexed load. Each entry names a function and the events it wants, such as event_pressed|event_repeated.
+ * The function receives the key name from the mapping array and the event, one of buttons_pressed, buttons_held, buttons_repeated and buttons_released. Use {0,0} for keys without a handler.
+*/
+#if phi_enable_key_handlers
+struct phi_key_handlers{
+  void (*handler)(byte key, byte event); ///< Function to call, or 0 for none.
+  byte events;            ///< Events this handler wants, such as event_pressed|event_released.
+};
+#endif
+
+/** \brief One entry in an analog calibration table
+ * \details Analog keypads can keep the ADC value of each key and how far a reading may stray from it, instead of the fixed values and analog_difference. See phi_keypads::set_calibration.
+*/
+#if phi_enable_calibration
+struct phi_analog_cal{
+  int center;             ///< Expected ADC reading of the key.
+  byte tolerance;         ///< Largest difference from center still taken as this key. This is measured, cut so it can't reach the keys next to it.
+  byte measured;          ///< Tolerance the key was calibrated with, before it is cut.
+};
+#endif
+
+#define analog_cal_max_spread 64    ///< calibrate_key fails if the readings of a held key spread more than this.
+#define analog_cal_min_tolerance 4  ///< Smallest tolerance calibrate_key sets, so a very quiet key still has some room to drift.
+#define integrator_count_max 0x7F   ///< Highest count set_integrator accepts. The counter's top bit holds the debounced state.
+#define integrator_down 0x80        ///< Bit of an integrator counter set while the key is debounced down.
+
+#if phi_enable_background_scan
+#ifndef keypad_timer_isr
+#define keypad_timer_isr 1          ///< Set to 0 if another library in your sketch defines ISR(TIMER0_COMPB_vect). phi_keypads::begin_timer() then does nothing and you call phi_keypads::scan_all() from a timer of your own.
+#endif
+
+/** \brief One key in a type-ahead buffer
+ * \details A keypad in background mode puts each key it finds here, with the status the key had at that moment, until getKey returns it. Key handlers found in the interrupt wait here too, for getKey to call. See phi_keypads::set_background.
 */
-class phi_keypads:public multiple_button_input {
+struct phi_typed_keys{
+  byte key;               ///< Key name, as getKey returns it.
+  byte status;            ///< Status of the key when it was found, such as buttons_pressed or buttons_held, or the event of a handler call.
+#if phi_enable_key_handlers
+  byte scan;              ///< NO_KEYs for a key, or the scan code of a key whose handler getKey calls.
+#endif
+};
+#endif
+
+class phi_keypads:public multiple_button_input, public phi_latency_histograms{
   public:
   byte keyboard_type;               ///< This stores the type of the keypad so a caller can use special functions for specific keypads.
   byte getKey();                    ///< Returns the key corresponding to the pressed button or NO_KEY.
-  unsigned long button_status_t;    ///< This is the time stamp of the sensed button first in the status stored in button_status.
+  unsigned long button_status_t;    ///< This is the time stamp of the sensed button first in the status stored in button_status, in clock ticks.
 
   virtual byte get_sensed();        ///< Get sensed button name. Replace this in children class if needed.
   virtual byte get_status();        ///< Get status of the button being sensed. Replace this in children class if needed.
+#if phi_enable_chords
+  void set_chords(phi_chords *ch, byte n, unsigned int window); ///< Registers a chord table. Pass n=0 to turn chords off.
+#endif
+#if phi_enable_slicing
+  void set_slice(byte units);       ///< Limits each getKey to sensing this many columns or analog pins. 0 (default) scans the whole keypad every call.
+#endif
+#if phi_enable_key_handlers
+  void set_handlers(const phi_key_handlers *table, byte n);   ///< Registers a key handler table in RAM, one entry per scan code. Pass n=0 to turn handlers off.
+  void set_handlers_P(const phi_key_handlers *table, byte n); ///< Registers a key handler table stored in PROGMEM.
+#endif
+#if phi_enable_layers
+  void set_layers(const char * const *layer_tables, byte n, char *table, byte keys); ///< Registers keymap layers in PROGMEM and the RAM table the active keymap is compiled into.
+  void set_layer_mask(byte mask);   ///< Turns on the layers whose bits are set and compiles the keymap.
+  void layer_on(byte layer) {set_layer_mask(layer_mask|(1<<layer));}   ///< Turns on one layer.
+  void layer_off(byte layer) {set_layer_mask(layer_mask&~(1<<layer));} ///< Turns off one layer.
+  byte get_layer_mask() {return layer_mask;} ///< Returns the layers that are on.
+#endif
+#if phi_enable_calibration
+  void set_calibration(phi_analog_cal *table, byte n); ///< Turns on per-key analog calibration with a RAM table, filled from the constructor's values.
+  byte calibrate_key(byte scan, byte samples); ///< Measures a key that is being held down. Returns 1 if the key was calibrated.
+  byte get_calibration_blob(byte *buf, byte size); ///< Copies the calibration into buf for EEPROM. Returns the number of bytes or 0.
+  byte set_calibration_blob(const byte *buf, byte size); ///< Loads a calibration saved with get_calibration_blob. Returns 1 if it was valid.
+#endif
+#if phi_enable_integrator
+  void set_integrator(byte *counters, byte keys, byte on, byte off, byte max); ///< Debounces with a counter per key instead of the debounce time. Pass keys=0 to turn it off.
+#endif
+#if phi_enable_background_scan
+  byte set_background(phi_typed_keys *buf, byte size); ///< Moves scanning into scan_all() and queues keys in buf for getKey. Pass size=0 to scan in getKey again. Returns 0 for a keypad that can't be scanned from an interrupt.
+  byte get_lost() {return typed_lost;} ///< Returns how many keys were thrown away because the type-ahead buffer was full.
+  static void scan_all();           ///< Scans every keypad in background mode once. Call it from a timer interrupt at a fixed rate, or let begin_timer() do it.
+  static void begin_timer(byte ms); ///< Calls scan_all() about every ms milliseconds from the timer 0 compare B interrupt on AVR.
+  static void end_timer();          ///< Stops the interrupt started by begin_timer().
+  static void timer_tick();         ///< Counts timer interrupts and calls scan_all() every ms of them. Called by the interrupt, not by your code.
+#endif
 
   protected:
+  phi_keypads();            ///< Initializes members shared by all keypads.
+#if phi_enable_chords
+  phi_chords * chords;      ///< Pointer to array of chords or NULL if no chords are registered.
+  byte chord_count;         ///< Number of chords in the chord array.
+  byte chord_state;         ///< One of the chord states such as chord_pending.
+  byte chord_match;         ///< Index of the chord currently matching the keys down or NO_KEYs.
+  unsigned int chord_window; ///< How long in ms a chord key is held back waiting for the rest of the chord.
+  unsigned long chord_keys; ///< Union of all chord masks, so a key can be checked against all chords with one AND.
+  unsigned long chord_seen; ///< Union of all keys seen down while the chord window is open.
+  unsigned long chord_t;    ///< Time stamp when the chord window opened.
+  unsigned long chord_match_t; ///< Time stamp when chord_match started matching.
+  byte scanChords(unsigned long mask); ///< Chord version of scanKeypad. Returns a key name instead of a scan code.
+#endif
+#if phi_enable_slicing
+  byte slice;               ///< Units sensed per getKey in time-sliced mode, or 0 for full scans.
+  byte slice_unit;          ///< Next unit to sense in the frame being collected.
+  unsigned long slice_mask; ///< Keys found so far in the frame being collected.
+  byte scan_slice(unsigned long *frame); ///< Senses the next slice of units. Returns 1 with the whole frame once the last unit is sensed.
+#endif
+#if phi_enable_key_handlers
+  const phi_key_handlers * handlers; ///< Key handler table or NULL.
+  byte handler_count;       ///< Number of entries in the key handler table.
+  byte handlers_in_flash;   ///< Non-zero if the key handler table is in PROGMEM.
+  void dispatch(byte scan, byte event); ///< Calls the handler of a key if it wants this event, or queues the call in background mode.
+  byte run_handler(byte scan, byte event, byte call=1); ///< Calls the handler of a key if it wants this event. Returns 1 if it does.
+#else
+  void dispatch(byte, byte) {}
+#endif
+#if phi_enable_layers
+  char * base_names;        ///< The mapping array given to the constructor, the bottom of the layer stack.
+  const char * const * layers; ///< Array of layer tables in PROGMEM or NULL.
+  byte layer_count;         ///< Number of layers.
+  byte layer_mask;          ///< Bit n is set if layer n is on.
+  byte layer_keys;          ///< Number of keys in each layer and in the compiled table.
+  char * layer_table;       ///< RAM table the active keymap is compiled into. key_names points here while layers are set.
+#endif
+#if phi_enable_calibration
+  phi_analog_cal * cal;     ///< Analog calibration table or NULL.
+  byte cal_count;           ///< Number of entries in the calibration table.
+  int cal_reading;          ///< Last reading matched against a calibrated key.
+  byte cal_reading_scan;    ///< Scan code cal_reading matched, or NO_KEYs.
+  byte cal_match(byte scan, int temp, int expected, int diff); ///< Matches a reading against a key, calibrated or not.
+  void key_confirmed(byte scan); ///< Nudges the calibration of a key toward its reading when a press is confirmed.
+  void separate_keys(byte scan); ///< Recomputes the tolerances of the keys on a pin or column so they can't overlap.
+/// Reads the raw ADC value behind a key for calibrate_key, or returns -1 on keypads that are not analog.
+  virtual int read_key_raw(byte) {return -1;}
+/// Returns the uncalibrated value and tolerance of a key.
+  virtual int key_value(byte, byte *tolerance) {*tolerance=0; return -1;}
+/// Returns which pin or column a key is read on. Keys on the same one must not overlap.
+  virtual byte key_channel(byte scan) {return scan;}
+#else
+  byte cal_match(byte, int temp, int expected, int diff) {return abs(expected-temp)<diff;}
+  void key_confirmed(byte) {}
+#endif
+#if phi_enable_integrator
+  byte * integrators;       ///< Per-key debounce counters or NULL to debounce with the debounce time.
+  byte integrator_keys;     ///< Number of counters.
+  byte integrator_on;       ///< Count at which a key becomes down.
+  byte integrator_off;      ///< Count at which a key becomes up again.
+  byte integrator_max;      ///< Highest count.
+  byte integrating() {return integrators!=0;} ///< Returns 1 if integrating debounce is on.
+  unsigned long integrate(unsigned long mask); ///< Steps the debounce counters with one scan and returns the debounced keys down.
+#else
+  byte integrating() {return 0;}
+  unsigned long integrate(unsigned long mask) {return mask;}
+#endif
+  unsigned long t_now;      ///< Clock sampled once at the start of each scan. All timing in the scan uses it.
+#if phi_enable_background_scan
+  volatile phi_typed_keys * typed; ///< Type-ahead buffer or NULL when scanning in getKey.
+  byte typed_size;          ///< Number of entries in the type-ahead buffer. One is always left empty to tell a full buffer from an empty one.
+  volatile byte typed_head; ///< Next entry scan_all writes. Only the interrupt changes it.
+  volatile byte typed_tail; ///< Next entry getKey reads. Only getKey changes it.
+  volatile byte typed_lost; ///< Keys thrown away because the buffer was full.
+  byte typed_status;        ///< Status of the key getKey returned last in background mode.
+  phi_keypads * next_background; ///< Next keypad in the list scan_all goes through.
+  static phi_keypads * background_list; ///< First keypad in background mode, or NULL.
+  static byte timer_ms;     ///< Timer interrupts between calls to scan_all.
+  static byte timer_count;  ///< Timer interrupts since the last call to scan_all.
+  void scan_background();   ///< Scans once and queues the key found, if any.
+  void push_typed(byte key, byte status, byte scan); ///< Adds a key or a handler call to the type-ahead buffer.
+#endif
+
   byte rows;                ///< Number of rows on a keypad. Rows are input pins. In analog keypads, each row pin is an analog pin.
   byte columns;             ///< Number of columns on a keypad. Columns are output pins when the column is addressed and tri-stated when the column is not addressed. In analog keypads, column represents number of buttons connected to each analog pin.
   byte buttonBits;          ///< This is the button bits. It's a temporary variable.
@@ -325,10 +802,34 @@ class phi_keypads:public multiple_button_input {
   char * key_names;         ///< Pointer to array of characters. Each key press is translated into a name from this array such as '0'.
 
   byte scanKeypad();        ///< Updates status of the keypad with button_sensed and button_status to provide information to getKey
+  byte scan_once();         ///< Senses the keypad and runs the state machine once. Returns the key name or NO_KEY.
+  unsigned long note_raw(unsigned long mask) {latency_sample(mask!=0,t_now); return mask;} ///< Passes a scan through, noting for the latency histogram whether it found anything.
+  byte update_status(byte button_pressed); ///< Runs the debounce and repeat state machine on one scan result.
+/// Time between repeats of a held key in clock ticks. Keypads that want a variable repeat rate replace this.
+  virtual unsigned long repeat_interval() {return buttons_repeat_ticks;}
 /// This senses all input pins.
   virtual byte sense_all()=0;
+/// This senses all input pins and returns every key that is down as a bit mask, bit n for scan code n. The default only reports the key sense_all finds.
+  virtual unsigned long sense_mask();
+/// Number of units (columns or analog pins) one frame is made of. The default 0 means the keypad can't be sliced and is always scanned whole.
+  virtual byte scan_units() {return 0;}
+/// Senses one unit and returns the keys down on it as a bit mask.
+  virtual unsigned long sense_unit(byte) {return 0;}
+/// Post-processes a complete frame, such as filtering ghost keys. The default returns the mask unchanged.
+  virtual unsigned long end_frame(unsigned long mask) {return mask;}
+/// Called once at the start of every getKey, before anything is sensed. Keypads that share their outputs with LEDs, such as for dimming, step them here. Returning 0 skips sensing on this call and getKey returns NO_KEY.
+  virtual byte start_scan() {return 1;}
+/// Called at the end of every getKey that sensed, so a keypad can hand its pins back to LEDs.
+  virtual void end_scan() {}
+#if phi_enable_background_scan
+/// Returns 1 if sensing waits on something, such as a conversion or a delay, so the keypad can't be scanned from an interrupt. set_background refuses such keypads.
+  virtual byte sense_blocks() {return 0;}
+#endif
 };
 
+#endif
+
+#if phi_enable_joysticks
 /*
        __    ______   ____    ____  _______.___________. __    ______  __  ___
       |  |  /  __  \  \   \  /   / /       |           ||  |  /      ||  |/  /
@@ -344,6 +845,8 @@ class phi_keypads:public multiple_button_input {
  * The sense_all reads digital pins for input.
  * The scanKeypad turns these inputs into status changes for keys and provide scan code of the pressed key. It handles status change including debouncing and repeat.
  * The getKey translates the key press from scan code (0 to max_key-1) into named keys with the mapping array.
+ * In proportional mode (set_proportional), the axes are measured from a calibrated center instead of matched against the three values per axis. Each axis is normalized to -127 to 127, a round deadzone is cut out of the middle, and the direction is split into 8 octants with integer math.
+ * The further the stick is pushed, the faster a held direction repeats, from the repeat time (set_repeat) at the edge of the deadzone to the dash time (set_dash) at full deflection.
 */
 class phi_joysticks:public phi_keypads {
   public:
@@ -352,14 +855,32 @@ class phi_joysticks:public phi_keypads {
   int get_x(){return axis_vals[0];} ///< Returns x axis value of the joystick
   int get_y(){return axis_vals[1];} ///< Returns y axis value of the joystick
   unsigned long button_status_t;    ///< This is the time stamp of the sensed button first in the status stored in button_status.
+  void set_proportional(byte on, byte dz); ///< Turns proportional mode on or off and sets the radial deadzone in normalized units (0-126).
+  void calibrate_center();          ///< Reads the axes at rest and takes them as the center. Call with the stick released.
+  int get_norm_x() {return norm_vals[0];} ///< Returns the x axis after deadzone, -127 to 127. Proportional mode only.
+  int get_norm_y() {return norm_vals[1];} ///< Returns the y axis after deadzone, -127 to 127. Proportional mode only.
+  byte get_deflection() {return deflection;} ///< Returns how far the stick is pushed past the deadzone, 0 to 127. Proportional mode only.
 
   protected:
   int axis_vals[2];         ///< This stores the x and y axis values read from analog pin
   int threshold;            ///< This stores the threshold of matching the joystick with a directional key.
   int * values;             ///< This pointer points to an integer array with values of analog inputs. The number of values is equal to the number of axis times 3. The array starts with the value of the first axis, when it is pushed up, then the center value of this axis, then the value of this axis when it is pushed down.
+  byte proportional;        ///< Non-zero in proportional mode.
+  byte deadzone;            ///< Radius of the deadzone in normalized units.
+  byte deflection;          ///< Distance past the deadzone, 0 to 127.
+  int centers[2];           ///< Calibrated center of each axis.
+  int norm_vals[2];         ///< Axes after normalization and deadzone, -127 to 127.
   byte sense_all(); ///< This senses all input pins.
+  byte sense_proportional(); ///< Turns axis_vals into a direction in proportional mode.
+  unsigned long repeat_interval(); ///< Scales the repeat time with deflection in proportional mode.
+#if phi_enable_background_scan
+  byte sense_blocks();      ///< Returns 1 unless both axes are scheduled with phi_adc_schedulers.
+#endif
 };
 
+#endif
+
+#if phi_enable_analog_keypads
 /*
      ___      .__   __.      ___       __        ______     _______
     /   \     |  \ |  |     /   \     |  |      /  __  \   /  _____|
@@ -383,8 +904,22 @@ class phi_analog_keypads: public phi_keypads{
   protected:
   int * values;             ///< This pointer points to an integer array with values of analog inputs. The number of dividers is equal to the number of buttons on each row. The values should increase monotonically, such as 0,146,342,513,744. A range of 10 between the stored and read values is taken as match to guarantee the match is good. These values apply to all columns so if you want to make a keypad with say three analog pins and 5 buttons on each pin, use the same button/resistor setup on all three pins.
   byte sense_all();         ///< This senses all analog input pins for change of key status.
+  unsigned long sense_mask(); ///< This senses all analog input pins and returns one key per pin as a bit mask.
+  byte scan_units() {return rows;} ///< One unit per analog pin.
+  unsigned long sense_unit(byte u); ///< Reads one analog pin.
+#if phi_enable_background_scan
+  byte sense_blocks();      ///< Returns 1 unless every analog pin is scheduled with phi_adc_schedulers.
+#endif
+#if phi_enable_calibration
+  int read_key_raw(byte scan); ///< Reads the analog pin of a key.
+  int key_value(byte scan, byte *tolerance); ///< Returns the value and tolerance of a key from the constructor's values.
+  byte key_channel(byte scan) {return scan/columns;} ///< Keys are grouped by analog pin.
+#endif
 };
 
+#endif
+
+#if phi_enable_matrix_keypads
 /*
 .___  ___.      ___   .___________..______       __  ___   ___
 |   \/   |     /   \  |           ||   _  \     |  | \  \ /  /
@@ -396,15 +931,28 @@ class phi_analog_keypads: public phi_keypads{
 /** \brief a class for matrix keypads of any size.
  * \details This is the actual class for matrix keypads, not the phi_keypads, which is a virtual class to support all keypad type of inputs.
  * Only one function needs to be implemented, the sense_all(). Everything higher level is the same across all keypad subclasses, defined in phi_keypads.
+ * Matrix keypads without diodes show a phantom (ghost) key when three keys that form three corners of a rectangle are pressed, since the fourth corner reads as pressed too.
+ * The ghost filter, on by default, finds every such rectangle in one full scan and drops the keys in it that weren't already down in the scan before, since a new ghost can't be told apart from a new real key. A key held before the rectangle formed is known to be real, so it stays down. Keys outside any rectangle still come through.
+ * Turn the filter off with set_ghost_filter(0) if your keypad has diodes. The filter works on keypads with up to 8 rows and 8 columns and 32 keys.
 */
 class phi_matrix_keypads: public phi_keypads{
   public:
   phi_matrix_keypads(char *na, byte * sp, byte r, byte c); ///< Constructor for matrix keypad.
+  void set_ghost_filter(byte on) {ghost_filter=on;} ///< Turns the ghost key filter on (1, default) or off (0).
 
   protected:
+  byte ghost_filter;        ///< Non-zero if keys in ghost rectangles are dropped from scans.
+  unsigned long ghost_last; ///< Keys down in the last filtered frame. These stay down when a rectangle forms around them.
   byte sense_all();         ///< This senses all input pins.
+  unsigned long sense_mask(); ///< This senses all input pins and returns all keys down as a bit mask.
+  byte scan_units() {return columns;} ///< One unit per column.
+  unsigned long sense_unit(byte u); ///< Drives one column and reads all rows.
+  unsigned long end_frame(unsigned long mask); ///< Drops new keys in ghost rectangles from a complete frame.
 };
 
+#endif
+
+#if phi_enable_button_groups
 /*
 .______    __    __  .___________.___________.  ______   .__   __.
 |   _  \  |  |  |  | |           |           | /  __  \  |  \ |  |
@@ -433,6 +981,43 @@ class phi_button_groups: public phi_keypads{
 
   protected:
   byte sense_all();         ///< This senses all input pins.
+  unsigned long sense_mask(); ///< This senses all input pins and returns all keys down as a bit mask.
+};
+
+#endif
+
+#if phi_enable_liudr_keypads
+/*
+ _______   __  .___  ___.
+|       \ |  | |   \/   |
+|  .--.  ||  | |  \  /  |
+|  |  |  ||  | |  |\/|  |
+|  '--'  ||  | |  |  |  |
+|_______/ |__| |__|  |__|
+*/
+#ifndef led_bam_bits
+#define led_bam_bits 4          ///< Bits of LED brightness. 4 gives levels 0 to 15 and a period of 15 scans. Define it before including phi_interfaces.h to change it.
+#endif
+#define led_level_max ((1<<led_bam_bits)-1) ///< Brightest LED level, always on.
+
+/** \brief LED brightness levels shared by phi_liudr_keypads and phi_liudr_keypads_2
+ * \details Each LED gets a level between 0 (off) and led_level_max (always on) with set_led_level, after set_led_dimming(1) on the keypad.
+ * Brightness is made with bit angle modulation. Levels are kept as bit planes, one byte per level bit with one bit per LED. Plane b is shown for 2 to the power of b scans, so a period is led_level_max scans and each LED is on for as many scans as its level.
+ * The time base is the keypad scan itself. Each getKey shows the next plane with the same shifts or pin writes the scan does anyway, so dimming costs no extra transfers on phi_liudr_keypads and only writes LED pins that change on phi_liudr_keypads_2.
+ * For even brightness call getKey at a steady rate, such as once every loop of 1ms, which gives a 67Hz period with 4 bits. LEDs hold their last plane while the keypad is not scanned.
+*/
+class phi_led_dimmers{
+  public:
+  void set_led_level(byte led, byte level); ///< Sets the brightness of one LED, 0 to led_level_max.
+  byte get_led_level(byte led);  ///< Returns the brightness of one LED.
+
+  protected:
+  byte led_planes[led_bam_bits]; ///< Bit plane b holds bit b of the level of every LED, LED n at bit n.
+  byte bam_step;            ///< Scans into the current period, 0 to led_level_max-1.
+  byte led_dimming;         ///< 1 if LEDs are dimmed, 0 if they are plain on/off.
+  void init_dimmer();       ///< Clears all levels and turns dimming off. Called by the keypad constructors.
+  void set_led_planes(byte on_bits); ///< Sets the LEDs in on_bits to led_level_max and the rest to 0.
+  byte bam_next();          ///< Steps one scan and returns the LED byte to show until the next scan.
 };
 
 /*
@@ -445,21 +1030,35 @@ class phi_button_groups: public phi_keypads{
 */
 /** \brief a class for Liudr's shift register LED keypad
  * \details This keypad class uses an undisclosed hardware design that incorporates a keypad and LED indicators. The details may be published in a future date and is not the focus of this library.
+ * The LED byte goes out with every scan shift. With set_led_deferred(1), setLed and setLedByte only change ledStatusBits and mark it dirty, and the change rides along with the next scan shift or goes out with flush_leds(), so updating all 8 LEDs costs at most one transfer.
+ * With set_led_dimming(1), each LED can have a brightness level, set with set_led_level. See phi_led_dimmers.
 */
-class phi_liudr_keypads: public phi_keypads{
+class phi_liudr_keypads: public phi_keypads, public phi_led_dimmers{
   public:
   phi_liudr_keypads(char *na, byte * sp, byte cp, byte dp, byte lp, byte r, byte c);    ///< Constructor for liudr keypad led panel
-  void setLed(byte led, byte on_off);   ///< Updates LED status using shift registers. Two bytes are shifted out.
-  void setLedByte(byte led);            ///< Updates LED status using shift registers. Two bytes are shifted out.
+  void setLed(byte led, byte on_off);   ///< Updates LED status using shift registers. Two bytes are shifted out unless LED updates are deferred or dimmed.
+  void setLedByte(byte led);            ///< Updates LED status using shift registers. Two bytes are shifted out unless LED updates are deferred or dimmed.
+  void set_led_deferred(byte on);       ///< Turns deferred LED updates on or off. Turning them off flushes pending changes.
+  byte flush_leds();                    ///< Shifts out pending LED changes. Returns 1 if there were any.
+  void set_led_dimming(byte on);        ///< Turns LED brightness levels on or off. See phi_led_dimmers.
 
   protected:
   byte clockPin;            ///< Clock pin for liudr shift register pad
   byte dataPin;             ///< Data pin for liudr shift register pad
   byte latchPin;            ///< Latch or storage pin for liudr shift register pad
   byte ledStatusBits;       ///< Contains the LED status bits of liudr shift register pad
+  byte led_deferred;        ///< 1 if setLed only marks ledStatusBits dirty
+  byte led_dirty;           ///< 1 if ledStatusBits changed since it was last shifted out
 
   byte sense_all();         ///< This senses all input pins.
+  unsigned long sense_mask(); ///< This senses all input pins and returns all keys down as a bit mask.
+  byte scan_units() {return columns;} ///< One unit per column.
+  unsigned long sense_unit(byte u); ///< Shifts out one column and reads all rows.
   void updateShiftRegister(byte first8, byte next8);    ///< This updates shift register with 2 bytes.
+  byte start_scan();        ///< Puts the next brightness plane in ledStatusBits so this scan's shifts carry it.
+#if phi_enable_background_scan
+  byte sense_blocks() {return 1;} ///< A scan shifts out every column, which takes longer than the timer period.
+#endif
 };
 
 /*
@@ -474,18 +1073,243 @@ class phi_liudr_keypads: public phi_keypads{
  * If you need less buttons, just don't connect that many and leave the rest of the circuit with all resistors untouched.
  * Only one function needs to be implemented, the sense_all(). Everything higher level is the same across all keypad subclasses, defined in phi_keypads.
  * You need to store 4 digital pin numbers after the button column pins for 4 LEDs to be driven.
+ * With set_led_dimming(1), each of the 4 LEDs can have a brightness level, set with set_led_level. See phi_led_dimmers.
+ * The keypad owns the column and LED pins in mySensorPins and keeps a cache of their direction and level, so only pins that really change are written. Don't write these pins from your sketch.
+ * LEDs and the analog reading can disturb each other. With set_scan_period, getKey alternates fixed phases instead: a scan phase where the LED pins float and the columns are driven, then an LED phase where the columns float and the LEDs are driven until the next scan is due.
+ * Scans then run at a fixed rate however often getKey is called, and the LEDs are lit for all but the scan phases. A scan phase takes one conversion per column, about 112us each on a 16MHz AVR, so 4 columns every 5000us keep the LEDs lit at least 91% of the time.
  * Find the sample circuit on my blog under http://liudr.wordpress.com/phi_interfaces/
 */
-class phi_liudr_keypads_2: public phi_keypads{
+class phi_liudr_keypads_2: public phi_keypads, public phi_led_dimmers{
   public:
   phi_liudr_keypads_2(char *na, byte * sp, byte asp, byte r, byte c, int * dp); ///< Constructor for liudr keypad version 2
   void setLed(byte led, byte on_off);   ///< Updates LED status using digital pins that are stored in mySensorPins array, after all the digital column pins.
   void setLedByte(byte led);            ///< Updates LED status using digital pins that are stored in mySensorPins array, after all the digital column pins.
+  void set_led_dimming(byte on);        ///< Turns LED brightness levels on or off. See phi_led_dimmers.
+  void set_scan_period(unsigned long us); ///< Alternates fixed scan and LED phases with one scan phase every us microseconds. 0 scans on every getKey.
 
   protected:
   byte analog_sensing_pin;	///< This is the analog pin
   int * values;             ///< This pointer points to an integer array with values of analog inputs. The number of dividers is equal to the number of buttons on each row. The values should increase monotonically, such as 0,146,342,513,744. A range of 50 between the stored and read values is taken as match to guarantee the match is good. These values apply to all columns. The last two values represents no buttons and a single button that connects the analog pin to 5V.
   byte sense_all();         ///< This scans the digital pins and senses the analog input pin for change of key status.
+  unsigned long sense_mask(); ///< This scans the digital pins and returns one key per column as a bit mask.
+  byte scan_units() {return columns;} ///< One unit per column.
+  unsigned long sense_unit(byte u); ///< Drives one column and converts the analog pin once.
+#if phi_enable_calibration
+  int read_key_raw(byte scan); ///< Drives the column of a key and converts the analog pin.
+  int key_value(byte scan, byte *tolerance); ///< Returns the value and tolerance of a key from the constructor's values.
+  byte key_channel(byte scan) {return (scan<rows*columns)?scan/rows:0;} ///< Keys are grouped by column. The 5V button reads the same on every column, so it is checked against column 0.
+#endif
+  byte led_bits;            ///< On/off status of the 4 LEDs set by setLed and setLedByte, LED n at bit n.
+  byte led_out;             ///< LED byte shown in the LED phase, led_bits or the brightness plane.
+  unsigned long pin_dir;    ///< Cached direction of mySensorPins, bit n set if pin n is an OUTPUT. The columns and 4 LED pins need to fit in 32 bits.
+  unsigned long pin_level;  ///< Cached level of mySensorPins, bit n set if pin n was written HIGH.
+  unsigned long scan_period;  ///< Clock ticks from one scan phase to the next, or 0 to scan on every getKey.
+  unsigned long last_scan_t;  ///< Clock ticks when the last scan phase was due.
+  void set_pin(byte n, byte mode, byte level); ///< Sets the mode and level of mySensorPins[n], writing only what changed.
+  void drive_column(byte u); ///< Drives column u LOW and floats the other columns.
+  void show_leds(byte bits); ///< Drives the 4 LED pins with bits.
+  void release_pins(byte first, byte n); ///< Floats n of mySensorPins starting at first.
+  byte start_scan();        ///< Steps dimming and decides between a scan phase and an LED phase.
+#if phi_enable_background_scan
+  byte sense_blocks() {return 1;} ///< Every column needs a fresh conversion, which can't be waited for in an interrupt.
+#endif
+  void end_scan();          ///< Ends a scan phase by floating the columns and driving the LEDs again.
+};
+
+#endif
+
+#if phi_enable_adc_schedulers
+/*
+     ___       _______       ______
+    /   \     |       \     /      |
+   /  ^  \    |  .--.  |   |  ,----'
+  /  /_\  \   |  |  |  |   |  |
+ /  _____  \  |  '--'  |   |  `----.
+/__/     \__\ |_______/     \______|
+*/
+#define adc_channels_max 8      ///< Maximal number of analog pins phi_adc_schedulers sequences.
+#define adc_settle_conversions 1 ///< Conversions thrown away after switching channels while the sample and hold capacitor settles.
+#ifndef adc_background_isr
+#define adc_background_isr 1    ///< Set to 0 if another library in your sketch defines ISR(ADC_vect). phi_adc_schedulers::begin() then does nothing and service() keeps polling.
+#endif
+
+/** \brief a round-robin scheduler that shares the one ADC among analog encoders and keypads without blocking
+ * \details Every analogRead waits about 100us for its conversion. With several analog devices, that wait adds up on every loop.
+ * Pins added to this scheduler are converted one after another in the background instead. Each call to service() checks whether the running conversion is done, stores it, switches the multiplexer to the next pin and starts the next conversion, all without waiting.
+ * The first conversion after a channel switch is thrown away so the sample and hold capacitor can settle. A new sample that differs from the one before by more than analog_difference is held back until it is confirmed by the next sample, so a reading caught mid-transition does not reach the devices.
+ * phi_analog_keypads and phi_rotary_encoders_a read scheduled pins from the latest sample table and call service() themselves, so each getKey costs a table lookup instead of a conversion. Pins that are not added are read with analogRead as before.
+ * Only one ADC exists, so everything in this class is static. Add pins in setup() after creating the devices:
+
+ phi_adc_schedulers::add_pin(A0);
+ phi_adc_schedulers::add_pin(A1);
+
+ * On AVR you may also call begin() after adding pins. The conversion complete interrupt then stores each conversion and starts the next one, so the sample table stays current without anyone calling service(), and reading a scheduled pin is a memory load.
+A callback set with set_callback() is called with each new sample. In background mode it runs inside the interrupt so keep it short.
+Pins that are not scheduled are still read with a blocking conversion. The background engine is paused for that conversion so the two don't fight over the multiplexer.
+phi_liudr_keypads_2 reads its sense pin this way on purpose: its voltage changes with the column being driven, so a background sample of it would be stale.
+On boards other than AVR, service() falls back to one blocking analogRead of the next pin per call, which still bounds the cost to one conversion per call no matter how many devices there are. begin() does nothing there.
+*/
+class phi_adc_schedulers{
+  public:
+  static byte add_pin(byte pin);            ///< Adds an analog pin to the round robin. Returns 1 if the pin is scheduled.
+  static byte has_pin(byte pin);            ///< Returns 1 if the pin is scheduled.
+  static void service();                    ///< Collects a finished conversion and starts the next one. Never waits.
+  static int get_sample(byte pin);          ///< Returns the latest filtered sample of a scheduled pin or -1.
+  static void set_reference(byte ref) {reference=ref;} ///< Sets the analog reference used by the scheduler, same values as analogReference(). Default is DEFAULT.
+  static void set_callback(void (*cb)(byte pin, int sample)) {callback=cb;} ///< Sets a function to call with each new sample, or 0 for none.
+  static void begin();                      ///< Starts interrupt driven background sampling on AVR.
+  static void end();                        ///< Stops background sampling and goes back to service() polling.
+  static int read_blocking(byte pin);       ///< Reads any analog pin with a conversion of its own, pausing background sampling meanwhile.
+  static void conversion_done(int val);     ///< Handles a finished conversion. Called by service() or the ADC interrupt, not by your code.
+
+  protected:
+  static byte pins[adc_channels_max];       ///< Scheduled pins, as passed to add_pin
+  static volatile int samples[adc_channels_max]; ///< Latest filtered sample of each pin
+  static int last_raw[adc_channels_max];    ///< Last raw conversion of each pin, used by the transition filter
+  static byte pin_count;                    ///< Number of scheduled pins
+  static volatile byte current;             ///< Index of the pin being converted
+  static volatile byte discard;             ///< Conversions left to throw away on the current pin
+  static volatile byte running;             ///< Non-zero while a conversion started by the scheduler is running
+  static byte background;                   ///< Non-zero while the ADC interrupt runs the round robin
+  static byte reference;                    ///< Analog reference
+  static void (*callback)(byte pin, int sample); ///< Called with each new sample
+  static void pause();                      ///< Stops the round robin after the running conversion.
+  static void resume();                     ///< Restarts the round robin on the current pin.
+  static void start(byte i);                ///< Switches the multiplexer to pin i and starts a conversion.
+  static void store(byte i, int val);       ///< Filters a conversion into the sample table.
+};
+#else
+/// Stand-in for phi_adc_schedulers when it is compiled out with phi_enable_adc_schedulers 0. Nothing is scheduled and every pin is read with analogRead.
+class phi_adc_schedulers{
+  public:
+  static byte add_pin(byte) {return 0;}
+  static byte has_pin(byte) {return 0;}
+  static void service() {}
+  static int get_sample(byte) {return -1;}
+  static void set_reference(byte) {}
+  static void set_callback(void (*)(byte pin, int sample)) {}
+  static void begin() {}
+  static void end() {}
+  static int read_blocking(byte pin) {return analogRead(pin);}
 };
+#endif
+
+int phi_analog_read(byte pin);  ///< Reads an analog pin through phi_adc_schedulers if it is scheduled, otherwise with analogRead.
+
+/*
+  _______ .______        ______    __    __  .______
+ /  _____||   _  \      /  __  \  |  |  |  | |   _  \
+|  |  __  |  |_)  |    |  |  |  | |  |  |  | |  |_)  |
+|  | |_ | |      /     |  |  |  | |  |  |  | |   ___/
+|  |__| | |  |\  \----.|  `--'  | |  `--'  | |  |
+ \______| | _| `._____| \______/   \______/  | _|
+*/
+#if phi_enable_device_groups && (__cplusplus >= 201103L)
+#define Device_group 12                 ///< A phi_device_groups object that merges several devices into one input.
+#define group_keys_max 8                ///< Keys phi_device_groups holds when several devices report in the same getKey.
+
+/// Keys phi_device_groups holds until getKey returns them, with what their device reported at the time.
+struct phi_group_keys{
+  char keys[group_keys_max];            ///< Keys waiting to be returned.
+  byte devs[group_keys_max];            ///< Device index of each waiting key.
+  byte status[group_keys_max];          ///< get_status of the device when its key was taken.
+  byte sensed[group_keys_max];          ///< get_sensed of the device when its key was taken.
+  byte head;                            ///< Index of the oldest waiting key.
+  byte count;                           ///< Number of waiting keys.
+  byte lost;                            ///< Keys thrown away because all group_keys_max were waiting.
+/// Adds a key, or counts it as lost if the queue is full.
+  void push(char key, byte dev, byte st, byte se)
+  {
+    if (count>=group_keys_max)
+    {
+      if (lost<255) lost++;
+      return;
+    }
+    byte slot=(head+count)%group_keys_max;
+    keys[slot]=key;
+    devs[slot]=dev;
+    status[slot]=st;
+    sensed[slot]=se;
+    count++;
+  }
+};
+
+/** \brief Recursive member list of phi_device_groups. Each level holds one device and calls it by its concrete type.
+ * \details Calls are qualified with the device's own class, such as dev.phi_matrix_keypads::getKey(), so the compiler calls that function directly instead of looking it up in the vtable.
+*/
+template<class... Devices> struct phi_device_chains;
+
+/// End of the member list.
+template<> struct phi_device_chains<>{
+  void poll(phi_group_keys &, byte) {}
+};
+
+/// One device and the rest of the list.
+template<class First, class... Rest> struct phi_device_chains<First, Rest...>{
+  First &dev;
+  phi_device_chains<Rest...> rest;
+  phi_device_chains(First &d, Rest&... r):dev(d),rest(r...) {}
+/// Polls this device and the rest, adding each key to q with its device index and the device's status at that moment.
+  void poll(phi_group_keys &q, byte idx)
+  {
+    char k=dev.First::getKey();
+    if (k!=NO_KEY) q.push(k,idx,dev.First::get_status(),dev.First::get_sensed());
+    rest.poll(q,idx+1);
+  }
+};
+
+/** \brief a group of devices of different types polled as one input, with no virtual call per device
+ * \details The device types are template arguments, so the group knows each member's class at compile time and calls its getKey, get_status and get_sensed directly. Polling a list of multiple_button_input pointers costs a virtual call per device instead.
+ * The group is itself a multiple_button_input, so phi_prompt and anything else that takes one can use it like a single keypad:
+
+ phi_matrix_keypads pad(mapping, pins, 4, 4);
+ phi_rotary_encoders_d knob(knob_keys, 10, 11, 20, EncoderType_NO);
+ phi_device_groups<phi_matrix_keypads, phi_rotary_encoders_d> both(pad, knob);
+ multiple_button_input *inputs[]={&both};
+
+ * Each getKey polls every member once. If more than one reports a key in the same call, the extra keys are held and returned by the next calls in device order. Up to group_keys_max keys are held. Keys beyond that are counted by get_lost and thrown away.
+ * get_status and get_sensed answer for the last key returned, with what its device said when the key was taken rather than what it says now. get_device tells which device that was.
+ * Timing such as set_hold and set_debounce is shared by all devices, so setting it on the group sets it for everyone.
+ * Only the group's own calls are direct. Inside a keypad's getKey, the calls that sense the hardware, such as sense_all, stay virtual as they are for any keypad, so the group saves one indirect call per device per poll, not the whole chain.
+ * Needs C++11, which the Arduino IDE has used since 1.6.6.
+*/
+template<class... Devices> class phi_device_groups: public multiple_button_input{
+  static_assert(sizeof...(Devices)>0, "phi_device_groups needs at least one device");
+  public:
+  phi_device_groups(Devices&... devs):chain(devs...)
+  {
+    device_type=Device_group;
+    queue.head=queue.count=queue.lost=0;
+    last_dev=0;
+    last_status=buttons_up;
+    last_sensed=NO_KEY;
+  }
+/// Polls every device and returns the oldest key reported, or NO_KEY.
+  byte getKey()
+  {
+    chain.poll(queue,0); // Every device is polled every time so none misses its timing, even while keys are held.
+    if (!queue.count) return NO_KEY;
+    byte i=queue.head;
+    last_dev=queue.devs[i];
+    last_status=queue.status[i];
+    last_sensed=queue.sensed[i];
+    queue.head=(i+1)%group_keys_max;
+    queue.count--;
+    return queue.keys[i];
+  }
+  byte get_status() {return last_status;}  ///< Status of the device that reported the last key, when the key was taken.
+  byte get_sensed() {return last_sensed;}  ///< Sensed key of the device that reported the last key, when the key was taken.
+  byte get_device() {return last_dev;}     ///< Index, in template argument order, of the device that reported the last key.
+  byte get_lost() {return queue.lost;}     ///< Returns how many keys were thrown away because group_keys_max keys were already waiting.
+  static byte size() {return sizeof...(Devices);} ///< Number of devices in the group.
+
+  protected:
+  phi_device_chains<Devices...> chain;  ///< References to the devices.
+  phi_group_keys queue;                 ///< Keys waiting to be returned.
+  byte last_dev;                        ///< Device that reported the last key returned.
+  byte last_status;                     ///< get_status of that device when its key was taken.
+  byte last_sensed;                     ///< get_sensed of that device when its key was taken.
+};
+#endif
 
 #endif
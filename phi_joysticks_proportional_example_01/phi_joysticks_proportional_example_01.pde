@@ -0,0 +1,53 @@
+/** \file
+ *  \brief     This is the first official release of the phi_interfaces library.
+ *  \details   This library unites buttons, rotary encoders and several types of keypads libraries under one library, the phi_interfaces library, for easy of use. This is the first official release. All currently supported input devices are buttons, matrix keypads, rotary encoders, analog buttons, and liudr pads. User is encouraged to obtain compatible hardware from liudr or is solely responsible for converting it to work on other shields or configurations.
+ *  \author    Dr. John Liu
+ *  \version   1.0
+ *  \date      01/24/2012
+ *  \pre       Compatible with Arduino IDE 1.0 and 0022.
+ *  \bug       Not tested on, Arduino IDE 0023 or arduino MEGA hardware!
+ *  \warning   PLEASE DO NOT REMOVE THIS COMMENT WHEN REDISTRIBUTING! No warranty!
+ *  \copyright Dr. John Liu. Free software for educational and personal uses. Commercial use without authorization is prohibited.
+ *  \par Contact
+ * Obtain the documentation or find details of the phi_interfaces, phi_prompt TUI library, Phi-2 shield, and Phi-panel hardware or contact Dr. Liu at:
+ *
+ * <a href="http://liudr.wordpress.com/phi_interfaces/">http://liudr.wordpress.com/phi_interfaces/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-panel/">http://liudr.wordpress.com/phi-panel/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi_prompt/">http://liudr.wordpress.com/phi_prompt/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-2-shield/">http://liudr.wordpress.com/phi-2-shield/</a>
+*/
+
+#include <phi_interfaces.h>
+
+char mapping[]={'Q','W','E','A',(char)NO_KEYs,'D','Z','X','C'}; // Top left, top, top right, left, middle, right, bottom left, bottom, bottom right. The middle is NO_KEYs.
+byte pins[]={0, 1}; // The x axis and the y axis. The pin numbers are analog pin numbers.
+int values[]={0, 512, 1023, 0, 512, 1023}; // Each axis pushed one way, at rest, and pushed the other way.
+phi_joysticks panel_joystick(mapping, pins, values, 100);
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println("Phi_interfaces library joystick proportional mode test code");
+  panel_joystick.set_proportional(1, 20); // Ignore the stick until it is pushed 20 out of 127 from the center.
+  panel_joystick.calibrate_center(); // Don't touch the stick while this runs.
+  panel_joystick.set_repeat(400); // A held direction repeats every 0.4s just past the deadzone,
+  panel_joystick.set_dash(50); // and every 0.05s when the stick is pushed all the way.
+}
+
+void loop()
+{
+  byte temp=panel_joystick.getKey();
+  if ((temp!=NO_KEY)&&(panel_joystick.get_status()!=buttons_released)) // A held direction is returned once more when the stick is let go.
+  {
+    Serial.write(temp);
+    Serial.print(" x=");
+    Serial.print(panel_joystick.get_norm_x());
+    Serial.print(" y=");
+    Serial.print(panel_joystick.get_norm_y());
+    Serial.print(" deflection=");
+    Serial.println(panel_joystick.get_deflection());
+  }
+}
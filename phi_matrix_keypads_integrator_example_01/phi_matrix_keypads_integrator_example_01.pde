@@ -0,0 +1,46 @@
+/** \file
+ *  \brief     This is the first official release of the phi_interfaces library.
+ *  \details   This library unites buttons, rotary encoders and several types of keypads libraries under one library, the phi_interfaces library, for easy of use. This is the first official release. All currently supported input devices are buttons, matrix keypads, rotary encoders, analog buttons, and liudr pads. User is encouraged to obtain compatible hardware from liudr or is solely responsible for converting it to work on other shields or configurations.
+ *  \author    Dr. John Liu
+ *  \version   1.0
+ *  \date      01/24/2012
+ *  \pre       Compatible with Arduino IDE 1.0 and 0022.
+ *  \bug       Not tested on, Arduino IDE 0023 or arduino MEGA hardware!
+ *  \warning   PLEASE DO NOT REMOVE THIS COMMENT WHEN REDISTRIBUTING! No warranty!
+ *  \copyright Dr. John Liu. Free software for educational and personal uses. Commercial use without authorization is prohibited.
+ *  \par Contact
+ * Obtain the documentation or find details of the phi_interfaces, phi_prompt TUI library, Phi-2 shield, and Phi-panel hardware or contact Dr. Liu at:
+ *
+ * <a href="http://liudr.wordpress.com/phi_interfaces/">http://liudr.wordpress.com/phi_interfaces/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-panel/">http://liudr.wordpress.com/phi-panel/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi_prompt/">http://liudr.wordpress.com/phi_prompt/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-2-shield/">http://liudr.wordpress.com/phi-2-shield/</a>
+*/
+
+#include <phi_interfaces.h>
+
+#define buttons_per_column 4
+#define buttons_per_row 4
+
+char mapping[]={'1','2','3','A','4','5','6','B','7','8','9','C','*','0','#','D'}; // This is a matrix keypad.
+byte pins[]={17, 16, 15, 13, 12, 11, 9, 8}; // The first four pins are rows, the next 4 are columns. If you have 4*3 pad, then the first 4 are rows and the next 3 are columns.
+phi_matrix_keypads panel_keypad(mapping, pins, buttons_per_row, buttons_per_column);
+byte counters[buttons_per_column*buttons_per_row]; // One debounce counter per key.
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println("Phi_interfaces library matrix keypad integrating debounce test code");
+  panel_keypad.set_integrator(counters, buttons_per_column*buttons_per_row, 4, 1, 5); // A key is down after 4 more down than up scans and up again when it falls back to 1. The debounce time is not used.
+}
+
+void loop()
+{
+  char temp;
+  temp=panel_keypad.getKey(); // Each call is one scan, so a press takes at least 4 calls to show up.
+  if (temp!=NO_KEY) Serial.write(temp);
+  delay(2); // Scans about every 2ms, so a clean press shows up after about 8ms and a chattering one a few scans later.
+}
@@ -0,0 +1,56 @@
+/** \file
+ *  \brief     This is the first official release of the phi_interfaces library.
+ *  \details   This library unites buttons, rotary encoders and several types of keypads libraries under one library, the phi_interfaces library, for easy of use. This is the first official release. All currently supported input devices are buttons, matrix keypads, rotary encoders, analog buttons, and liudr pads. User is encouraged to obtain compatible hardware from liudr or is solely responsible for converting it to work on other shields or configurations.
+ *  \author    Dr. John Liu
+ *  \version   1.0
+ *  \date      01/24/2012
+ *  \pre       Compatible with Arduino IDE 1.0 and 0022.
+ *  \bug       Not tested on, Arduino IDE 0023 or arduino MEGA hardware!
+ *  \warning   PLEASE DO NOT REMOVE THIS COMMENT WHEN REDISTRIBUTING! No warranty!
+ *  \copyright Dr. John Liu. Free software for educational and personal uses. Commercial use without authorization is prohibited.
+ *  \par Contact
+ * Obtain the documentation or find details of the phi_interfaces, phi_prompt TUI library, Phi-2 shield, and Phi-panel hardware or contact Dr. Liu at:
+ *
+ * <a href="http://liudr.wordpress.com/phi_interfaces/">http://liudr.wordpress.com/phi_interfaces/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-panel/">http://liudr.wordpress.com/phi-panel/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi_prompt/">http://liudr.wordpress.com/phi_prompt/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-2-shield/">http://liudr.wordpress.com/phi-2-shield/</a>
+*/
+
+#include <phi_interfaces.h>
+
+#define total_encoders 8
+#define EncoderDetent 12
+
+char mapping[]={'U','D','L','R','A','B','W','S','I','O','+','-','<','>','[',']'}; // Two names per encoder, dial up then dial down.
+byte pins[]={2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17}; // Channels A and B of each encoder. Pins on the same port are read together.
+phi_rotary_encoder_banks my_encoders(mapping, pins, total_encoders, EncoderDetent, EncoderType_NO);
+multiple_button_input* dials=&my_encoders;
+long positions[total_encoders];
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println("Phi_interfaces library rotary encoder bank test code");
+}
+
+void loop()
+{
+  signed char deltas[total_encoders];
+  if (my_encoders.poll(deltas)) // One call reads all 8 encoders.
+  {
+    for (byte i=0;i<total_encoders;i++)
+    {
+      positions[i]+=deltas[i];
+      Serial.print(positions[i]);
+      Serial.print(' ');
+    }
+    Serial.println();
+  }
+
+//  char temp=dials->getKey(); // Use the generic multiple_button_interface instead to get one named dial up or down at a time.
+//  if (temp!=NO_KEY) Serial.println(temp);
+}
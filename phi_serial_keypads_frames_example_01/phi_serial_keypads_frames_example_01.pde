@@ -0,0 +1,62 @@
+/** \file
+ *  \brief     This is the first official release of the phi_interfaces library.
+ *  \details   This library unites buttons, rotary encoders and several types of keypads libraries under one library, the phi_interfaces library, for easy of use. This is the first official release. All currently supported input devices are buttons, matrix keypads, rotary encoders, analog buttons, and liudr pads. User is encouraged to obtain compatible hardware from liudr or is solely responsible for converting it to work on other shields or configurations.
+ *  \author    Dr. John Liu
+ *  \version   1.0
+ *  \date      01/24/2012
+ *  \pre       Compatible with Arduino IDE 1.0 and 0022.
+ *  \bug       Not tested on, Arduino IDE 0023 or arduino MEGA hardware!
+ *  \warning   PLEASE DO NOT REMOVE THIS COMMENT WHEN REDISTRIBUTING! No warranty!
+ *  \copyright Dr. John Liu. Free software for educational and personal uses. Commercial use without authorization is prohibited.
+ *  \par Contact
+ * Obtain the documentation or find details of the phi_interfaces, phi_prompt TUI library, Phi-2 shield, and Phi-panel hardware or contact Dr. Liu at:
+ *
+ * <a href="http://liudr.wordpress.com/phi_interfaces/">http://liudr.wordpress.com/phi_interfaces/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-panel/">http://liudr.wordpress.com/phi-panel/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi_prompt/">http://liudr.wordpress.com/phi_prompt/</a>
+ *
+ * <a href="http://liudr.wordpress.com/phi-2-shield/">http://liudr.wordpress.com/phi-2-shield/</a>
+*/
+
+#include <phi_interfaces.h>
+
+#define buttons_per_column 4
+#define buttons_per_row 4
+#define events_per_frame 8
+
+// This sketch runs on a remote panel. Every key event of its matrix keypad is forwarded to the host on Serial, in frames of up to 8 events.
+// On the host Arduino, create phi_serial_keypads host_link(&Serial, 115200); give it a receive ring with set_frame_buffers(ring, sizeof(ring), 0, 0) and call getKey or read_event as usual.
+
+char mapping[]={'1','2','3','A','4','5','6','B','7','8','9','C','*','0','#','D'}; // This is a matrix keypad.
+byte pins[]={17, 16, 15, 13, 12, 11, 9, 8}; // The first four pins are rows, the next 4 are columns. If you have 4*3 pad, then the first 4 are rows and the next 3 are columns.
+phi_matrix_keypads panel_keypad(mapping, pins, buttons_per_row, buttons_per_column);
+
+phi_serial_keypads panel_link(&Serial, 115200);
+byte tx_frame[serial_frame_bytes(events_per_frame)]; // The frame is built here in place.
+
+void forward(byte key, byte event)
+{
+  panel_link.queue_event(key,event);
+}
+
+phi_key_handlers handlers[buttons_per_column*buttons_per_row];
+
+void setup()
+{
+  Serial.begin(115200);
+  panel_link.set_frame_buffers(0, 0, tx_frame, sizeof(tx_frame)); // This panel only sends.
+  for (byte i=0;i<buttons_per_column*buttons_per_row;i++)
+  {
+    handlers[i].handler=forward;
+    handlers[i].events=event_all;
+  }
+  panel_keypad.set_handlers(handlers, buttons_per_column*buttons_per_row);
+}
+
+void loop()
+{
+  panel_keypad.getKey(); // Events queue up through forward().
+  panel_link.flush_events(); // Whatever was queued since the last loop goes out as one frame.
+}